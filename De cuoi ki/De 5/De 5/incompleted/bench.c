@@ -0,0 +1,123 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+/* DOUBLE literal conversion benchmark, built with "make bench".
+ *
+ * Converts the literals of a generated numeric program with the decimal
+ * parser readNumber uses, with atof on the scanned string as readNumber
+ * used to, and with strtod. Every result of the decimal parser must be
+ * bit for bit the one strtod gives. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "decimal.h"
+
+#define LITERAL_COUNT 1000000
+#define MAX_LITERAL_LEN 32
+#define BENCH_ROUNDS 5
+
+char literals[LITERAL_COUNT][MAX_LITERAL_LEN];
+double results[LITERAL_COUNT];
+
+unsigned long seed = 20081;
+
+int nextRandom(int bound) {
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return (int) ((seed >> 33) % bound);
+}
+
+double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Mostly short fixed point constants like 3.14 or 0.5, with some long
+ * ones as printed by other programs, and some tiny ones */
+void makeLiterals(void) {
+  int i, k, n;
+
+  for (i = 0; i < LITERAL_COUNT; i++) {
+    char *s = literals[i];
+    int kind = nextRandom(10);
+
+    n = 0;
+    if (kind < 6) {
+      for (k = 1 + nextRandom(4); k > 0; k--) s[n++] = '0' + nextRandom(10);
+      s[n++] = '.';
+      for (k = 1 + nextRandom(5); k > 0; k--) s[n++] = '0' + nextRandom(10);
+    } else if (kind < 9) {
+      s[n++] = '1' + nextRandom(9);
+      s[n++] = '.';
+      for (k = 16 + nextRandom(5); k > 0; k--) s[n++] = '0' + nextRandom(10);
+    } else {
+      s[n++] = '0';
+      s[n++] = '.';
+      for (k = 5 + nextRandom(10); k > 0; k--) s[n++] = '0';
+      for (k = 1 + nextRandom(8); k > 0; k--) s[n++] = '0' + nextRandom(10);
+    }
+    s[n] = '\0';
+  }
+}
+
+/* Feeds the characters one at a time, as readNumber does */
+double convertDecimal(const char *s) {
+  Decimal decimal;
+
+  initDecimal(&decimal);
+  for (; *s != '\0'; s++) {
+    if (*s == '.') addDecimalPoint(&decimal);
+    else addDecimalDigit(&decimal, *s - '0');
+  }
+  return decimalToDouble(&decimal);
+}
+
+double convertAtof(const char *s) {
+  return atof(s);
+}
+
+double convertStrtod(const char *s) {
+  return strtod(s, NULL);
+}
+
+void measure(char *name, double (*convert)(const char*)) {
+  double best = 0;
+  int round, i;
+
+  for (round = 0; round < BENCH_ROUNDS; round ++) {
+    double start = now(), elapsed;
+    for (i = 0; i < LITERAL_COUNT; i++)
+      results[i] = convert(literals[i]);
+    elapsed = now() - start;
+    if ((best == 0) || (elapsed < best)) best = elapsed;
+  }
+  printf("  %-20s %8.1f Mliterals/s\n", name, LITERAL_COUNT / best / 1e6);
+}
+
+int main(void) {
+  int i, mismatches = 0;
+
+  makeLiterals();
+
+  printf("DOUBLE literals, %d of them\n", LITERAL_COUNT);
+  measure("decimal parser", convertDecimal);
+  measure("atof", convertAtof);
+  measure("strtod", convertStrtod);
+
+  for (i = 0; i < LITERAL_COUNT; i++) {
+    double expected = strtod(literals[i], NULL);
+    double actual = convertDecimal(literals[i]);
+    if (memcmp(&expected, &actual, sizeof(double)) != 0) {
+      if (mismatches ++ < 10)
+        printf("  mismatch on %s: %.17g, expected %.17g\n", literals[i], actual, expected);
+    }
+  }
+  printf("  %d mismatches against strtod\n", mismatches);
+  return (mismatches == 0) ? 0 : 1;
+}
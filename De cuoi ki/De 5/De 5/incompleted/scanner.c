@@ -8,12 +8,14 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <limits.h>
 
 #include "reader.h"
 #include "charcode.h"
 #include "token.h"
 #include "error.h"
 #include "scanner.h"
+#include "decimal.h"
 
 
 extern int lineNo;
@@ -99,25 +101,37 @@ Token *readString() {
 
 Token *readNumber(void) {
     Token *token = makeToken(TK_NUMBER, lineNo, colNo);
-    int count = 0;
+    Decimal decimal;
+    long value = 0;
+    int count = 0, digit;
 
+    // both values are built from the digits as they are read; the
+    // string only keeps the first MAX_IDENT_LEN characters
+    initDecimal(&decimal);
     while ((currentChar != EOF) && (charCodes[currentChar] == CHAR_DIGIT)) {
-        token->string[count++] = currentChar;
+        digit = currentChar - '0';
+        addDecimalDigit(&decimal, digit);
+        // saturate like atoi did on overflow
+        if (value > (LONG_MAX - digit) / 10) value = LONG_MAX;
+        else value = value * 10 + digit;
+        if (count < MAX_IDENT_LEN) token->string[count++] = currentChar;
         readChar();
     }
-    if (charCodes[currentChar] == CHAR_PERIOD) {
-        token->string[count++] = currentChar;
+    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_PERIOD)) {
+        addDecimalPoint(&decimal);
+        if (count < MAX_IDENT_LEN) token->string[count++] = currentChar;
         readChar();
         while ((currentChar != EOF) && (charCodes[currentChar] == CHAR_DIGIT)) {
-            token->string[count++] = currentChar;
+            addDecimalDigit(&decimal, currentChar - '0');
+            if (count < MAX_IDENT_LEN) token->string[count++] = currentChar;
             readChar();
         }
         token->string[count] = '\0';
         token->tokenType = TK_DOUBLE;
-        token->dValue = atof(token->string);
+        token->dValue = decimalToDouble(&decimal);
     } else {
         token->string[count] = '\0';
-        token->value = atoi(token->string);
+        token->value = (int) value;
     }
     return token;
 }
@@ -0,0 +1,41 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __DECIMAL_H__
+#define __DECIMAL_H__
+
+#include <stdint.h>
+
+#define MAX_DECIMAL_DIGITS 800
+
+/* A decimal literal fed one character at a time by the scanner and
+ * turned into the nearest double, without going through a string.
+ *
+ * The first 19 significant digits are kept as a 64-bit mantissa for the
+ * fast path. All of them, up to MAX_DECIMAL_DIGITS, are kept as digit
+ * values for the exact slow path, which handles the rare literals the
+ * fast path cannot round with certainty. */
+typedef struct {
+  uint64_t mantissa;       /* the first 19 significant digits */
+  int exponent;            /* the literal is about mantissa * 10^exponent */
+  int significant;         /* significant digits seen so far */
+  int inexact;             /* some nonzero digit is not in mantissa */
+  int pointSeen;
+
+  unsigned char digits[MAX_DECIMAL_DIGITS];
+  int digitCount;
+  int decimalPoint;        /* the literal is 0.digits * 10^decimalPoint */
+  int truncated;           /* some nonzero digit is not in digits */
+} Decimal;
+
+void initDecimal(Decimal *decimal);
+void addDecimalDigit(Decimal *decimal, int digit);
+void addDecimalPoint(Decimal *decimal);
+
+/* The double nearest to the literal, ties to even */
+double decimalToDouble(Decimal *decimal);
+
+#endif
@@ -11,6 +11,7 @@
 #include "parser.h"
 #include "semantics.h"
 #include "error.h"
+#include "strpool.h"
 #include "debug.h"
 
 
@@ -840,6 +841,7 @@ int compile(char *fileName) {
 
     free(currentToken);
     free(lookAhead);
+    freeStringPool();
     closeInputStream();
     return IO_SUCCESS;
 
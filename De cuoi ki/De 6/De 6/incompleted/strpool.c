@@ -0,0 +1,88 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "strpool.h"
+
+#define MIN_POOL_TABLE_SIZE 64
+
+extern char *inputBuffer;
+
+StringSlice *pooledStrings = NULL;   /* indexed by id */
+int pooledCount = 0;
+int pooledCapacity = 0;
+
+int *poolTable = NULL;                /* open addressing; id + 1, or 0 */
+int poolTableSize = 0;
+
+unsigned hashSlice(const char *text, int length) {
+  unsigned hash = 2166136261u;
+  int i;
+
+  for (i = 0; i < length; i++)
+    hash = (hash ^ (unsigned char) text[i]) * 16777619u;
+  return hash;
+}
+
+void growPoolTable(void) {
+  int size = (poolTableSize == 0) ? MIN_POOL_TABLE_SIZE : 2 * poolTableSize;
+  int id, slot;
+
+  free(poolTable);
+  poolTable = (int*) calloc(size, sizeof(int));
+  poolTableSize = size;
+
+  for (id = 0; id < pooledCount; id++) {
+    StringSlice *s = &pooledStrings[id];
+    slot = hashSlice(inputBuffer + s->offset, s->length) & (size - 1);
+    while (poolTable[slot] != 0)
+      slot = (slot + 1) & (size - 1);
+    poolTable[slot] = id + 1;
+  }
+}
+
+int internString(int offset, int length) {
+  const char *text = inputBuffer + offset;
+  int slot;
+
+  // keep the table at most half full
+  if (2 * (pooledCount + 1) > poolTableSize)
+    growPoolTable();
+
+  slot = hashSlice(text, length) & (poolTableSize - 1);
+  while (poolTable[slot] != 0) {
+    StringSlice *s = &pooledStrings[poolTable[slot] - 1];
+    if ((s->length == length) && (memcmp(inputBuffer + s->offset, text, length) == 0))
+      return poolTable[slot] - 1;
+    slot = (slot + 1) & (poolTableSize - 1);
+  }
+
+  if (pooledCount == pooledCapacity) {
+    pooledCapacity = (pooledCapacity == 0) ? MIN_POOL_TABLE_SIZE : 2 * pooledCapacity;
+    pooledStrings = (StringSlice*) realloc(pooledStrings, pooledCapacity * sizeof(StringSlice));
+  }
+  pooledStrings[pooledCount].offset = offset;
+  pooledStrings[pooledCount].length = length;
+  poolTable[slot] = pooledCount + 1;
+  return pooledCount ++;
+}
+
+StringSlice *getPooledString(int id) {
+  return &pooledStrings[id];
+}
+
+int pooledStringCount(void) {
+  return pooledCount;
+}
+
+void freeStringPool(void) {
+  free(pooledStrings);
+  free(poolTable);
+  pooledStrings = NULL;
+  poolTable = NULL;
+  pooledCount = pooledCapacity = poolTableSize = 0;
+}
@@ -32,7 +32,8 @@ typedef struct {
   char string[MAX_IDENT_LEN + 1];
   int lineNo, colNo;
   TokenType tokenType;
-  char *sValue;
+  int sOffset, sLength;   /* a TK_STRING's text, as a slice of the input */
+  int stringId;           /* and its id in the string pool */
   double  dValue;
   int value;
 } Token;
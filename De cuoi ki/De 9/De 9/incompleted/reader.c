@@ -5,14 +5,20 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include "reader.h"
 
-FILE *inputStream;
+#define INPUT_CHUNK_SIZE 65536
+
+char *inputBuffer;      /* the whole input, read by openInputStream */
+int inputSize;
+int charOffset;         /* offset of currentChar in inputBuffer */
 int lineNo, colNo;
 int currentChar;
 
 int readChar(void) {
-  currentChar = getc(inputStream);
+  charOffset ++;
+  currentChar = (charOffset < inputSize) ? (unsigned char) inputBuffer[charOffset] : EOF;
   colNo ++;
   if (currentChar == '\n') {
     lineNo ++;
@@ -22,16 +28,35 @@ int readChar(void) {
 }
 
 int openInputStream(char *fileName) {
-  inputStream = fopen(fileName, "rt");
-  if (inputStream == NULL)
+  FILE *f = fopen(fileName, "rt");
+  int capacity = INPUT_CHUNK_SIZE;
+  size_t n;
+
+  if (f == NULL)
     return IO_ERROR;
+
+  // text mode may shrink the file, so read until EOF rather than by size
+  inputBuffer = (char*) malloc(capacity);
+  inputSize = 0;
+  while ((n = fread(inputBuffer + inputSize, 1, capacity - inputSize, f)) > 0) {
+    inputSize += n;
+    if (inputSize == capacity) {
+      capacity *= 2;
+      inputBuffer = (char*) realloc(inputBuffer, capacity);
+    }
+  }
+  fclose(f);
+
   lineNo = 1;
   colNo = 0;
+  charOffset = -1;
   readChar();
   return IO_SUCCESS;
 }
 
 void closeInputStream() {
-  fclose(inputStream);
+  free(inputBuffer);
+  inputBuffer = NULL;
+  inputSize = 0;
 }
 
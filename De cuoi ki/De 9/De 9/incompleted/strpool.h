@@ -0,0 +1,27 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __STRPOOL_H__
+#define __STRPOOL_H__
+
+/* String literals stay where they are in the input buffer and are
+ * described by their slice of it. The pool keeps one slice per distinct
+ * text, so literals with the same text share an id, and its size follows
+ * the number of distinct strings rather than the number of literals.
+ * Slices are valid until the input is closed. */
+typedef struct {
+  int offset;
+  int length;
+} StringSlice;
+
+/* The id of the text of length bytes at offset in the input buffer */
+int internString(int offset, int length);
+StringSlice *getPooledString(int id);
+int pooledStringCount(void);
+
+void freeStringPool(void);
+
+#endif
@@ -0,0 +1,138 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ast.h"
+
+#define MIN_AST_CAPACITY 256
+
+Ast *newAst(void) {
+  Ast *ast = (Ast*) calloc(1, sizeof(Ast));
+
+  // node 0 is never a child, so that 0 can stand for none
+  ast->nodeCapacity = MIN_AST_CAPACITY;
+  ast->nodes = (AstNode*) calloc(ast->nodeCapacity, sizeof(AstNode));
+  ast->nodeCount = 1;
+  return ast;
+}
+
+void freeAst(Ast *ast) {
+  if (ast == NULL) return;
+  free(ast->nodes);
+  free(ast->pending);
+  free(ast->marks);
+  free(ast);
+}
+
+AstNode *pushPending(Ast *ast) {
+  if (ast->pendingCount == ast->pendingCapacity) {
+    ast->pendingCapacity = (ast->pendingCapacity == 0) ? MIN_AST_CAPACITY : 2 * ast->pendingCapacity;
+    ast->pending = (AstNode*) realloc(ast->pending, ast->pendingCapacity * sizeof(AstNode));
+  }
+  return &ast->pending[ast->pendingCount ++];
+}
+
+void pushMark(Ast *ast, uint32_t mark) {
+  if (ast->markCount == ast->markCapacity) {
+    ast->markCapacity = (ast->markCapacity == 0) ? 64 : 2 * ast->markCapacity;
+    ast->marks = (uint32_t*) realloc(ast->marks, ast->markCapacity * sizeof(uint32_t));
+  }
+  ast->marks[ast->markCount ++] = mark;
+}
+
+void initNode(AstNode *node, NodeKind kind, uint8_t op, SourceOffset offset, uint32_t value) {
+  node->kind = (uint8_t) kind;
+  node->op = op;
+  node->reserved = 0;
+  node->offset = offset;
+  node->value = value;
+  node->first = 0;
+  node->count = 0;
+}
+
+void openNode(Ast *ast, NodeKind kind, uint8_t op, SourceOffset offset, uint32_t value) {
+  if (ast == NULL) return;
+  initNode(pushPending(ast), kind, op, offset, value);
+  pushMark(ast, ast->pendingCount);
+}
+
+void openNodeAround(Ast *ast, NodeKind kind, uint8_t op, SourceOffset offset) {
+  AstNode *node;
+  uint32_t start;
+
+  if (ast == NULL) return;
+  // the node goes in before the child closed last. Without one since
+  // the innermost open node, it is opened with no child instead
+  start = (ast->markCount > 0) ? ast->marks[ast->markCount - 1] : 0;
+  if (ast->pendingCount == start) {
+    openNode(ast, kind, op, offset, 0);
+    return;
+  }
+  node = pushPending(ast);
+  node[0] = node[-1];
+  initNode(node - 1, kind, op, offset, 0);
+  pushMark(ast, ast->pendingCount - 1);
+}
+
+void closeNode(Ast *ast) {
+  uint32_t mark, count;
+  AstNode *node;
+
+  if (ast == NULL) return;
+  mark = ast->marks[-- ast->markCount];
+  count = ast->pendingCount - mark;
+  node = &ast->pending[mark - 1];
+
+  if (ast->nodeCount + count > ast->nodeCapacity) {
+    while (ast->nodeCount + count > ast->nodeCapacity)
+      ast->nodeCapacity *= 2;
+    ast->nodes = (AstNode*) realloc(ast->nodes, ast->nodeCapacity * sizeof(AstNode));
+  }
+  memcpy(ast->nodes + ast->nodeCount, ast->pending + mark, count * sizeof(AstNode));
+  node->first = (count > 0) ? ast->nodeCount : 0;
+  node->count = count;
+  ast->nodeCount += count;
+  ast->pendingCount = mark;
+}
+
+void addLeaf(Ast *ast, NodeKind kind, SourceOffset offset, uint32_t value) {
+  if (ast == NULL) return;
+  initNode(pushPending(ast), kind, 0, offset, value);
+}
+
+void finishAst(Ast *ast) {
+  if ((ast == NULL) || (ast->pendingCount != 1) || (ast->markCount != 0)) return;
+  // the root was closed last, so it goes after all the other nodes
+  if (ast->nodeCount == ast->nodeCapacity) {
+    ast->nodeCapacity *= 2;
+    ast->nodes = (AstNode*) realloc(ast->nodes, ast->nodeCapacity * sizeof(AstNode));
+  }
+  ast->nodes[ast->nodeCount] = ast->pending[0];
+  ast->root = ast->nodeCount ++;
+  ast->pendingCount = 0;
+}
+
+AstMark markAst(Ast *ast) {
+  AstMark mark = {0, 0, 0};
+
+  if (ast != NULL) {
+    mark.nodeCount = ast->nodeCount;
+    mark.pendingCount = ast->pendingCount;
+    mark.markCount = ast->markCount;
+  }
+  return mark;
+}
+
+void resetAst(Ast *ast, AstMark mark) {
+  if (ast == NULL) return;
+  // only nodes opened since have been closed since, as opening and
+  // closing are nested, so the nodes moved to the arena since were all
+  // children of nodes that are dropped too
+  ast->nodeCount = mark.nodeCount;
+  ast->pendingCount = mark.pendingCount;
+  ast->markCount = mark.markCount;
+}
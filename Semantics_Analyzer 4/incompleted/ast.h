@@ -0,0 +1,104 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __AST_H__
+#define __AST_H__
+
+#include <stdint.h>
+#include "token.h"
+
+typedef uint32_t NodeIndex;
+
+typedef enum {
+  AST_PROGRAM,        /* name; the block */
+  AST_BLOCK,          /* the declarations, then the body, an AST_GROUP */
+  AST_CONST_DECL,     /* name; the constant */
+  AST_TYPE_DECL,      /* name; the type */
+  AST_VAR_DECL,       /* name; the type */
+  AST_FUNC_DECL,      /* name; the parameters, the return type, the block */
+  AST_PROC_DECL,      /* name; the parameters, the block */
+  AST_PARAM,          /* name, op the ParamKind; the type */
+
+  AST_INT_TYPE,
+  AST_CHAR_TYPE,
+  AST_ARRAY_TYPE,     /* value the size; the element type */
+  AST_NAMED_TYPE,     /* name */
+
+  AST_EMPTY,
+  AST_ASSIGN,         /* the variable, the expression */
+  AST_GROUP,          /* the statements */
+  AST_IF,             /* the condition, the statement, the else statement if any */
+  AST_WHILE,          /* the condition, the statement */
+  AST_FOR,            /* name of the variable; the bounds, the statement */
+  AST_CALL,           /* name of the procedure or function; the arguments */
+
+  AST_COMPARE,        /* op the comparison; the two expressions */
+  AST_UNARY,          /* op the sign; the operand */
+  AST_BINARY,         /* op the operator; the two operands */
+  AST_NUMBER,         /* value */
+  AST_CHAR,           /* value the character code */
+  AST_NAME,           /* name of a constant, variable or parameter */
+  AST_INDEX,          /* name of the array; the indexes */
+  AST_ERROR           /* what an error was recovered from */
+} NodeKind;
+
+/* Every node has the same fixed size header. Nodes refer to each other by
+ * index in the arena, and the children of a node are next to each other
+ * there: they are nodes first to first + count - 1. */
+typedef struct {
+  uint8_t kind;             /* NodeKind */
+  uint8_t op;               /* TokenType of an operator or comparison */
+  uint16_t reserved;
+  SourceOffset offset;      /* of its first token, or of its operator */
+  uint32_t value;           /* a number, a char code, or the atom of a name */
+  NodeIndex first;
+  uint32_t count;
+} AstNode;
+
+/* A tree is built bottom up: a node is opened, its children are built,
+ * and when it is closed they are moved to the arena together. Until
+ * then they are kept on the pending stack, after their open parent. All the
+ * functions below do nothing on a NULL tree, so that the parser calls
+ * them whether it builds a tree or not. */
+typedef struct {
+  AstNode *nodes;           /* the arena */
+  uint32_t nodeCount;
+  uint32_t nodeCapacity;
+  AstNode *pending;         /* closed nodes whose parent is not yet */
+  uint32_t pendingCount;
+  uint32_t pendingCapacity;
+  uint32_t *marks;          /* for each open node, where its children start */
+  uint32_t markCount;
+  uint32_t markCapacity;
+  NodeIndex root;
+} Ast;
+
+/* Where building stands, to go back to after an error */
+typedef struct {
+  uint32_t nodeCount;
+  uint32_t pendingCount;
+  uint32_t markCount;
+} AstMark;
+
+Ast *newAst(void);
+void freeAst(Ast *ast);
+
+/* Opens a node; the nodes closed until it is are its children */
+void openNode(Ast *ast, NodeKind kind, uint8_t op, SourceOffset offset, uint32_t value);
+/* Opens a node whose first child is the node closed last, or with no
+ * child if no node was closed since the innermost open one was opened */
+void openNodeAround(Ast *ast, NodeKind kind, uint8_t op, SourceOffset offset);
+void closeNode(Ast *ast);
+/* Opens and closes a node without children */
+void addLeaf(Ast *ast, NodeKind kind, SourceOffset offset, uint32_t value);
+/* Moves the root, the one node closed with none open, to the arena */
+void finishAst(Ast *ast);
+
+AstMark markAst(Ast *ast);
+/* Drops the nodes opened and closed since mark */
+void resetAst(Ast *ast, AstMark mark);
+
+#endif
@@ -0,0 +1,223 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "atom.h"
+
+#define ATOM_BUCKETS (1 << 16)
+#define MIN_ATOM_BUCKETS 64
+/* Spellings are looked up in pages that never move, each twice the size
+ * of the one before, so that a table for a small input stays small */
+#define ATOM_FIRST_PAGE 64
+#define ATOM_PAGES 18
+#define MAX_ATOMS (ATOM_FIRST_PAGE * ((1u << ATOM_PAGES) - 1))
+/* Entries are carved out of blocks, which double in size up to this */
+#define MIN_ATOM_BLOCK 1024
+#define MAX_ATOM_BLOCK (1 << 20)
+
+typedef struct AtomEntry {
+  struct AtomEntry *next;
+  uint32_t hash;
+  Atom atom;
+  size_t length;
+  char name[];
+} AtomEntry;
+
+typedef struct AtomBlock {
+  struct AtomBlock *next;
+} AtomBlock;
+
+/* Lookups walk the chains without locking: an entry is complete before
+ * it is published at the head of its bucket, and is never changed or
+ * freed until the table is, with the blocks it is in. Adding one takes
+ * the lock. */
+struct AtomTable {
+  AtomEntry **buckets;
+  uint32_t bucketMask;
+  Atom count;                           /* atom 0 is NO_ATOM */
+  pthread_mutex_t lock;
+  const char **pages[ATOM_PAGES];       /* atom -> spelling */
+  AtomBlock *blocks;                    /* the newest first */
+  char *blockCursor, *blockLimit;       /* what is left of the newest */
+  size_t nextBlockSize;
+};
+
+AtomEntry *processBuckets[ATOM_BUCKETS];
+AtomTable processAtoms = { processBuckets, ATOM_BUCKETS - 1, 1, PTHREAD_MUTEX_INITIALIZER, { NULL },
+                          NULL, NULL, NULL, MIN_ATOM_BLOCK };
+
+/* Per thread, like the error state, so that each compile uses its own */
+__thread AtomTable *currentAtoms = NULL;
+
+AtomTable *atomTable(void) {
+  return (currentAtoms != NULL) ? currentAtoms : &processAtoms;
+}
+
+AtomTable *newAtomTable(size_t sourceSize) {
+  AtomTable *table = (AtomTable*) calloc(1, sizeof(AtomTable));
+  uint32_t buckets = MIN_ATOM_BUCKETS;
+
+  if (table == NULL)
+    return NULL;
+  // about one bucket per 16 bytes of source, which holds fewer names
+  while ((buckets < ATOM_BUCKETS) && (buckets < sourceSize / 16))
+    buckets <<= 1;
+  table->buckets = (AtomEntry**) calloc(buckets, sizeof(AtomEntry*));
+  if (table->buckets == NULL) {
+    free(table);
+    return NULL;
+  }
+  table->bucketMask = buckets - 1;
+  table->count = 1;
+  table->nextBlockSize = MIN_ATOM_BLOCK;
+  pthread_mutex_init(&table->lock, NULL);
+  return table;
+}
+
+void freeAtomTable(AtomTable *table) {
+  AtomBlock *block, *next;
+  int i;
+
+  if ((table == NULL) || (table == &processAtoms))
+    return;
+  for (block = table->blocks; block != NULL; block = next) {
+    next = block->next;
+    free(block);
+  }
+  for (i = 0; i < ATOM_PAGES; i++)
+    free(table->pages[i]);
+  pthread_mutex_destroy(&table->lock);
+  free(table->buckets);
+  free(table);
+}
+
+/* Room for an entry of size bytes, or NULL when memory runs out */
+AtomEntry *allocEntry(AtomTable *table, size_t size) {
+  AtomBlock *block;
+  char *entry;
+  size_t blockSize = table->nextBlockSize;
+
+  size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+  if ((size_t) (table->blockLimit - table->blockCursor) < size) {
+    if (blockSize < sizeof(AtomBlock) + size)
+      blockSize = sizeof(AtomBlock) + size;
+    block = (AtomBlock*) malloc(blockSize);
+    if (block == NULL)
+      return NULL;
+    block->next = table->blocks;
+    table->blocks = block;
+    table->blockCursor = (char*) (block + 1);
+    table->blockLimit = (char*) block + blockSize;
+    if (table->nextBlockSize < MAX_ATOM_BLOCK)
+      table->nextBlockSize *= 2;
+  }
+  entry = table->blockCursor;
+  table->blockCursor += size;
+  return (AtomEntry*) entry;
+}
+
+/* The page atom is on, and where on it */
+int atomPage(Atom atom, uint32_t *slot) {
+  int page = 31 - __builtin_clz(atom / ATOM_FIRST_PAGE + 1);
+
+  *slot = atom - ATOM_FIRST_PAGE * ((1u << page) - 1);
+  return page;
+}
+
+AtomTable *setAtomTable(AtomTable *table) {
+  AtomTable *previous = currentAtoms;
+  currentAtoms = table;
+  return previous;
+}
+
+AtomTable *getAtomTable(void) {
+  return currentAtoms;
+}
+
+uint32_t hashName(const char *name, size_t length) {
+  uint32_t hash = 2166136261u;
+  size_t i;
+
+  for (i = 0; i < length; i++)
+    hash = (hash ^ (unsigned char) name[i]) * 16777619u;
+  return hash;
+}
+
+AtomEntry *findEntry(AtomEntry *entry, uint32_t hash, const char *name, size_t length) {
+  for (; entry != NULL; entry = entry->next)
+    if ((entry->hash == hash) && (entry->length == length) && (memcmp(entry->name, name, length) == 0))
+      return entry;
+  return NULL;
+}
+
+Atom internRun(const char *name, size_t length) {
+  AtomTable *table = atomTable();
+  uint32_t hash = hashName(name, length);
+  AtomEntry **bucket = &table->buckets[hash & table->bucketMask];
+  AtomEntry *entry;
+  Atom atom;
+  uint32_t slot;
+  int page;
+
+  entry = findEntry(__atomic_load_n(bucket, __ATOMIC_ACQUIRE), hash, name, length);
+  if (entry != NULL)
+    return entry->atom;
+
+  pthread_mutex_lock(&table->lock);
+
+  // another thread may have added it since the lookup above
+  entry = findEntry(*bucket, hash, name, length);
+  if (entry != NULL) {
+    pthread_mutex_unlock(&table->lock);
+    return entry->atom;
+  }
+
+  // the table is full, or out of memory: the name gets no atom and the
+  // caller reports it
+  atom = table->count;
+  if (atom == MAX_ATOMS) {
+    pthread_mutex_unlock(&table->lock);
+    return NO_ATOM;
+  }
+  page = atomPage(atom, &slot);
+  if (table->pages[page] == NULL)
+    table->pages[page] = (const char**) malloc((ATOM_FIRST_PAGE << page) * sizeof(const char*));
+  entry = (table->pages[page] != NULL) ? allocEntry(table, sizeof(AtomEntry) + length + 1) : NULL;
+  if (entry == NULL) {
+    pthread_mutex_unlock(&table->lock);
+    return NO_ATOM;
+  }
+
+  entry->hash = hash;
+  entry->atom = atom;
+  entry->length = length;
+  memcpy(entry->name, name, length);
+  entry->name[length] = '\0';
+  entry->next = *bucket;
+
+  table->pages[page][slot] = entry->name;
+  table->count ++;
+  __atomic_store_n(bucket, entry, __ATOMIC_RELEASE);
+
+  pthread_mutex_unlock(&table->lock);
+  return atom;
+}
+
+Atom internName(const char *name) {
+  return internRun(name, strlen(name));
+}
+
+const char *atomName(Atom atom) {
+  uint32_t slot;
+  int page;
+
+  if (atom == NO_ATOM) return "";
+  page = atomPage(atom, &slot);
+  return atomTable()->pages[page][slot];
+}
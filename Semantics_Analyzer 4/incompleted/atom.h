@@ -0,0 +1,50 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __ATOM_H__
+#define __ATOM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Every distinct identifier spelling is interned once, at scan time, and
+ * referred to by its atom from then on; two names are equal exactly when
+ * their atoms are. Atoms belong to a table, and only mean something to
+ * the table they came from.
+ *
+ * Each compile interns into a table of its own, which its result keeps
+ * until it is freed, so that a batch or a long-running process does not
+ * keep the names of every input it has seen. Code that sets no table
+ * uses one shared by the whole process, which lives as long as the
+ * process and never shrinks; something long-running that re-lexes text,
+ * such as an editor, should give it a table of its own instead. A table
+ * may be used by several threads at once, each having set it. */
+typedef uint32_t Atom;
+typedef struct AtomTable AtomTable;
+
+#define NO_ATOM 0
+
+/* A new empty table, sized for names from about sourceSize bytes of
+ * source; NULL if memory runs out */
+AtomTable *newAtomTable(size_t sourceSize);
+/* Frees table and the spellings of its atoms */
+void freeAtomTable(AtomTable *table);
+
+/* Sets the table of the calling thread, or NULL for the process-wide
+ * one; returns the one set before */
+AtomTable *setAtomTable(AtomTable *table);
+AtomTable *getAtomTable(void);
+
+/* The atom of the length bytes at name in the table of the calling
+ * thread, or NO_ATOM when it is new and the table is full or memory
+ * runs out. A table holds nearly 16M atoms. */
+Atom internRun(const char *name, size_t length);
+Atom internName(const char *name);
+
+/* The spelling of atom, valid as long as its table is */
+const char *atomName(Atom atom);
+
+#endif
@@ -0,0 +1,407 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "reader.h"
+#include "batch.h"
+
+#define MAX_BATCH_JOBS 256
+/* Files per worker in a window of the batch, see compileBatch */
+#define BATCH_WINDOW_PER_JOB 8
+
+/* A file of the batch, and what became of it */
+typedef struct {
+  char *fileName;
+  size_t size;                /* as it was before the batch started */
+  int status;
+  CompileResult *result;
+  double latency;
+  int done;
+} BatchFile;
+
+/* The files a worker has yet to compile, by index in the batch. Its
+ * owner takes them from the head, the other workers from the tail. */
+typedef struct {
+  pthread_mutex_t lock;
+  int *files;
+  int head, tail;
+} JobQueue;
+
+struct Batch_;
+
+typedef struct {
+  struct Batch_ *batch;
+  int id;
+  JobQueue queue;
+  char *buffer;               /* holds the file being compiled */
+  size_t bufferSize;
+  pthread_t thread;
+  int threaded;
+} Worker;
+
+typedef struct Batch_ {
+  BatchFile *files;
+  int count;
+  Worker *workers;
+  int jobs;
+  int window;                 /* files dealt out together */
+  pthread_mutex_t lock;       /* guards the done flags and handled */
+  pthread_cond_t finished;
+  int handled;                /* files passed to the handler so far */
+  pthread_cond_t progress;    /* handled has grown */
+} Batch;
+
+double batchClock(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Largest first; files of the same size in the order they were given */
+int compareFileSizes(const void *a, const void *b) {
+  const BatchFile *fa = *(const BatchFile* const*) a;
+  const BatchFile *fb = *(const BatchFile* const*) b;
+
+  if (fa->size != fb->size)
+    return (fa->size > fb->size) ? -1 : 1;
+  return (fa < fb) ? -1 : (fa > fb);
+}
+
+int compareLatencies(const void *a, const void *b) {
+  double la = *(const double*) a;
+  double lb = *(const double*) b;
+  return (la > lb) - (la < lb);
+}
+
+#define NO_FILE_LEFT (-1)
+#define NO_FILE_YET (-2)
+
+/* Takes the next file of the worker's own queue if its index is below
+ * limit; NO_FILE_LEFT if the queue is empty, NO_FILE_YET if not */
+int takeOwnFile(Worker *worker, int limit) {
+  JobQueue *queue = &worker->queue;
+  int file = NO_FILE_LEFT;
+
+  pthread_mutex_lock(&queue->lock);
+  if (queue->head < queue->tail) {
+    file = queue->files[queue->head];
+    if (file < limit) queue->head ++;
+    else file = NO_FILE_YET;
+  }
+  pthread_mutex_unlock(&queue->lock);
+  return file;
+}
+
+/* Takes the smallest file left in the queue of another worker, trying
+ * them in turn from the next one on, or its next one if the smallest is
+ * not below limit. No file is queued once the batch has started, so
+ * when every queue is empty the worker is done. */
+int stealFile(Worker *worker, int limit) {
+  Batch *batch = worker->batch;
+  JobQueue *queue;
+  int file = NO_FILE_LEFT, k;
+
+  for (k = 1; (k < batch->jobs) && (file < 0); k ++) {
+    queue = &batch->workers[(worker->id + k) % batch->jobs].queue;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->head < queue->tail) {
+      if (queue->files[queue->tail - 1] < limit)
+        file = queue->files[-- queue->tail];
+      else if (queue->files[queue->head] < limit)
+        file = queue->files[queue->head ++];
+      else file = NO_FILE_YET;
+    }
+    pthread_mutex_unlock(&queue->lock);
+  }
+  return file;
+}
+
+/* A file for worker to compile next, NO_FILE_YET if it has to wait for
+ * the handler to catch up, or NO_FILE_LEFT */
+int takeFile(Worker *worker, int limit) {
+  int own = takeOwnFile(worker, limit), stolen;
+
+  if (own >= 0)
+    return own;
+  stolen = stealFile(worker, limit);
+  return (stolen == NO_FILE_LEFT) ? own : stolen;
+}
+
+/* Reads file into the worker's buffer, which grows to fit the largest
+ * file the worker has seen and is reused for the next ones */
+size_t readBatchFile(Worker *worker, BatchFile *file) {
+  struct stat st;
+  size_t size = 0;
+  ssize_t n;
+  int fd;
+
+  file->status = IO_ERROR;
+  fd = open(file->fileName, O_RDONLY);
+  if (fd < 0)
+    return 0;
+  if ((fstat(fd, &st) != 0) || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return 0;
+  }
+  if ((unsigned long long) st.st_size > MAX_SOURCE_SIZE) {
+    file->status = IO_TOO_LARGE;
+    close(fd);
+    return 0;
+  }
+
+  if ((size_t) st.st_size + 1 > worker->bufferSize) {
+    free(worker->buffer);
+    worker->bufferSize = st.st_size + 1;
+    worker->buffer = (char*) malloc(worker->bufferSize);
+  }
+  if (worker->buffer != NULL) {
+    file->status = IO_SUCCESS;
+    while (size < (size_t) st.st_size) {
+      n = pread(fd, worker->buffer + size, st.st_size - size, size);
+      if (n < 0) file->status = IO_ERROR;
+      if (n <= 0) break;
+      size += n;
+    }
+  } else worker->bufferSize = 0;
+  close(fd);
+  return size;
+}
+
+void compileBatchFile(Worker *worker, int index) {
+  Batch *batch = worker->batch;
+  BatchFile *file = &batch->files[index];
+  double start;
+  size_t size;
+
+  start = batchClock();
+  size = readBatchFile(worker, file);
+  // each compilation runs in a context of its own, lexed on this thread
+  // alone since the workers keep the processors busy already
+  if (file->status == IO_SUCCESS)
+    file->result = compileBuffer(worker->buffer, size);
+  file->latency = batchClock() - start;
+
+  pthread_mutex_lock(&batch->lock);
+  file->done = 1;
+  pthread_cond_broadcast(&batch->finished);
+  pthread_mutex_unlock(&batch->lock);
+}
+
+/* The files a worker may start: those less than two windows past the
+ * first one not handled yet */
+int fileLimit(Batch *batch) {
+  int limit;
+
+  pthread_mutex_lock(&batch->lock);
+  limit = batch->handled + 2 * batch->window;
+  pthread_mutex_unlock(&batch->lock);
+  return limit;
+}
+
+void *batchWorker(void *arg) {
+  Worker *worker = (Worker*) arg;
+  Batch *batch = worker->batch;
+  int index, limit;
+
+  setLexThreads(1);
+  for (;;) {
+    limit = fileLimit(batch);
+    index = takeFile(worker, limit);
+    if (index == NO_FILE_LEFT)
+      break;
+    if (index == NO_FILE_YET) {
+      pthread_mutex_lock(&batch->lock);
+      while (batch->handled + 2 * batch->window == limit)
+        pthread_cond_wait(&batch->progress, &batch->lock);
+      pthread_mutex_unlock(&batch->lock);
+      continue;
+    }
+    compileBatchFile(worker, index);
+  }
+  return NULL;
+}
+
+/* Compiles a file of a worker that has no thread of its own, on the
+ * calling thread; returns 0 if none of them has one it may start */
+int compileInline(Batch *batch) {
+  int limit = fileLimit(batch), index, k, previous;
+
+  for (k = 0; k < batch->jobs; k ++) {
+    if (batch->workers[k].threaded)
+      continue;
+    index = takeFile(&batch->workers[k], limit);
+    if (index >= 0) {
+      previous = setLexThreads(1);
+      compileBatchFile(&batch->workers[k], index);
+      setLexThreads(previous);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void compileBatch(char **fileNames, int count, int jobs, ResultHandler handler, void *arg, BatchStats *stats) {
+  Batch batch;
+  BatchFile **order;
+  BatchFile *file;
+  Worker *worker;
+  struct stat st;
+  double start, *latencies;
+  int i, k;
+
+  start = batchClock();
+  if (jobs <= 0)
+    jobs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  if (jobs > count)
+    jobs = count;
+  if (jobs > MAX_BATCH_JOBS)
+    jobs = MAX_BATCH_JOBS;
+  if (jobs < 1)
+    jobs = 1;
+
+  batch.files = (BatchFile*) calloc(count + 1, sizeof(BatchFile));
+  batch.count = count;
+  batch.workers = (Worker*) calloc(jobs, sizeof(Worker));
+  batch.jobs = jobs;
+  batch.window = BATCH_WINDOW_PER_JOB * jobs;
+  batch.handled = 0;
+  pthread_mutex_init(&batch.lock, NULL);
+  pthread_cond_init(&batch.finished, NULL);
+  pthread_cond_init(&batch.progress, NULL);
+
+  // the files are dealt out window by window, each largest first, so
+  // that a big one is not started last and left to hold up the end of
+  // its window. Results are handled in order, so a worker does not run
+  // more than two windows ahead of the handler: the results of a big
+  // file early on do not have every later one pile up behind them.
+  order = (BatchFile**) malloc((count + 1) * sizeof(BatchFile*));
+  for (i = 0; i < count; i ++) {
+    file = &batch.files[i];
+    file->fileName = fileNames[i];
+    file->status = IO_ERROR;
+    if (stat(fileNames[i], &st) == 0)
+      file->size = st.st_size;
+    order[i] = file;
+  }
+  for (i = 0; i < count; i += batch.window)
+    qsort(order + i, (count - i < batch.window) ? count - i : batch.window, sizeof(BatchFile*), compareFileSizes);
+
+  for (k = 0; k < jobs; k ++) {
+    worker = &batch.workers[k];
+    worker->batch = &batch;
+    worker->id = k;
+    worker->queue.files = (int*) malloc((count / jobs + 1) * sizeof(int));
+    pthread_mutex_init(&worker->queue.lock, NULL);
+  }
+  for (i = 0; i < count; i ++) {
+    worker = &batch.workers[i % jobs];
+    worker->queue.files[worker->queue.tail ++] = order[i] - batch.files;
+  }
+
+  for (k = 0; k < jobs; k ++) {
+    worker = &batch.workers[k];
+    worker->threaded = (pthread_create(&worker->thread, NULL, batchWorker, worker) == 0);
+  }
+
+  for (i = 0; i < count; i ++) {
+    file = &batch.files[i];
+    // the files of workers without a thread are compiled here, as
+    // long as the next result is not in
+    pthread_mutex_lock(&batch.lock);
+    while (!file->done) {
+      pthread_mutex_unlock(&batch.lock);
+      if (!compileInline(&batch)) {
+        pthread_mutex_lock(&batch.lock);
+        if (!file->done)
+          pthread_cond_wait(&batch.finished, &batch.lock);
+      } else pthread_mutex_lock(&batch.lock);
+    }
+    pthread_mutex_unlock(&batch.lock);
+
+    handler(i, file->fileName, file->status, file->result, arg);
+    if (file->result != NULL)
+      freeCompileResult(file->result);
+    file->result = NULL;
+
+    pthread_mutex_lock(&batch.lock);
+    batch.handled = i + 1;
+    pthread_cond_broadcast(&batch.progress);
+    pthread_mutex_unlock(&batch.lock);
+  }
+
+  // every worker is joined before any queue goes: one still looking
+  // for a file to steal locks the queues of the others
+  for (k = 0; k < jobs; k ++)
+    if (batch.workers[k].threaded)
+      pthread_join(batch.workers[k].thread, NULL);
+  for (k = 0; k < jobs; k ++) {
+    worker = &batch.workers[k];
+    pthread_mutex_destroy(&worker->queue.lock);
+    free(worker->queue.files);
+    free(worker->buffer);
+  }
+
+  if (stats != NULL) {
+    stats->files = count;
+    stats->jobs = jobs;
+    stats->seconds = batchClock() - start;
+    stats->filesPerSecond = (stats->seconds > 0) ? count / stats->seconds : 0;
+    stats->p99Latency = 0;
+    if (count > 0) {
+      latencies = (double*) malloc(count * sizeof(double));
+      for (i = 0; i < count; i ++)
+        latencies[i] = batch.files[i].latency;
+      qsort(latencies, count, sizeof(double), compareLatencies);
+      // the smallest latency at least 99% of the files are within
+      stats->p99Latency = latencies[(99 * count + 99) / 100 - 1];
+      free(latencies);
+    }
+  }
+
+  pthread_mutex_destroy(&batch.lock);
+  pthread_cond_destroy(&batch.finished);
+  pthread_cond_destroy(&batch.progress);
+  free(order);
+  free(batch.workers);
+  free(batch.files);
+}
+
+int readManifest(char *manifestName, char ***fileNames) {
+  FILE *f = fopen(manifestName, "r");
+  char *line = NULL;
+  size_t lineSize = 0, length;
+  int count = 0, capacity = 0;
+
+  *fileNames = NULL;
+  if (f == NULL)
+    return -1;
+
+  while (getline(&line, &lineSize, f) >= 0) {
+    length = strlen(line);
+    while ((length > 0) && ((line[length - 1] == '\n') || (line[length - 1] == '\r') ||
+                            (line[length - 1] == ' ') || (line[length - 1] == '\t')))
+      line[-- length] = '\0';
+    if (length == 0)
+      continue;
+    if (count == capacity) {
+      capacity = (capacity == 0) ? 64 : 2 * capacity;
+      *fileNames = (char**) realloc(*fileNames, capacity * sizeof(char*));
+    }
+    (*fileNames)[count ++] = strdup(line);
+  }
+
+  free(line);
+  fclose(f);
+  return count;
+}
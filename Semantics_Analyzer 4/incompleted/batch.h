@@ -0,0 +1,40 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include "parser.h"
+
+/* How a batch went */
+typedef struct {
+  int files;
+  int jobs;               /* worker threads used */
+  double seconds;         /* wall time of the whole batch */
+  double filesPerSecond;
+  double p99Latency;      /* seconds to read and compile a file, 99th percentile */
+} BatchStats;
+
+/* Called for each file of a batch with its result, or NULL with status
+ * IO_ERROR if the file could not be read or IO_TOO_LARGE if it is longer
+ * than MAX_SOURCE_SIZE. The result is freed when the handler returns. */
+typedef void (*ResultHandler)(int index, char *fileName, int status, CompileResult *result, void *arg);
+
+/* Compiles count files on jobs worker threads, or one per processor
+ * when jobs is 0, each lexing its files on its own. The files are dealt
+ * out to queues of the workers in windows of 8 per worker, each window
+ * largest first, and a worker takes files from the back of the others'
+ * queues once its own is empty. handler is called on the calling
+ * thread, in the order of fileNames, as soon as the files before it are
+ * done; no worker starts a file two windows or more past the next one
+ * to be handled, so that few results wait behind a slow file. */
+void compileBatch(char **fileNames, int count, int jobs, ResultHandler handler, void *arg, BatchStats *stats);
+
+/* Reads the file names of a manifest, one per line; blank lines are
+ * skipped. Returns the number of names, or -1 if it cannot be read. */
+int readManifest(char *manifestName, char ***fileNames);
+
+#endif
@@ -0,0 +1,557 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+/* Scanner micro benchmarks, built with "make bench".
+ *
+ * Each case runs over a generated source held in memory and reports the
+ * throughput in MB/s. The "readChar loop" rows are the character at a
+ * time loops the scanner used before the block kernels.
+ *
+ * Before anything is timed, the streams of the parallel lexer and of the
+ * re-lexer are checked against tokenizeInput of the same text; nothing
+ * is measured if they differ. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ctype.h>
+
+#include "reader.h"
+#include "charcode.h"
+#include "charscan.h"
+#include "token.h"
+#include "scanner.h"
+#include "tokstream.h"
+
+#define BENCH_SIZE (32 * 1024 * 1024)
+#define BENCH_ROUNDS 5
+#define CHECK_EDITS 20000
+#define CHECK_TEXT_SIZE 4096
+#define MAX_CHECK_THREADS 8
+
+extern const CharCode charCodes[];
+
+typedef const char *(*ScanKernel)(const char *p, const char *limit);
+extern ScanKernel spaceKernel, commentKernel;
+
+const char *skipSpaceRunScalar(const char *p, const char *limit);
+const char *findCommentEndScalar(const char *p, const char *limit);
+#ifdef __SSE2__
+const char *skipSpaceRunSSE2(const char *p, const char *limit);
+const char *findCommentEndSSE2(const char *p, const char *limit);
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+const char *skipSpaceRunAVX2(const char *p, const char *limit);
+const char *findCommentEndAVX2(const char *p, const char *limit);
+#endif
+
+void skipBlank(Scanner *scanner);
+void skipComment(Scanner *scanner);
+Token* readIdentKeyword(Scanner *scanner, Token *token);
+Token* readNumber(Scanner *scanner, Token *token);
+
+double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Deeply indented statements: whitespace runs separated by one letter */
+char *makeIndented(size_t size) {
+  char *text = (char*) malloc(size);
+  size_t i = 0;
+  int depth = 0;
+
+  while (i < size) {
+    int n = 4 * (depth % 8) + 1, k;
+    for (k = 0; (k < n) && (i < size); k++)
+      text[i++] = ' ';
+    if (i < size) text[i++] = 'x';
+    for (k = 0; (k < 3) && (i < size); k++)
+      text[i++] = ' ';
+    if (i < size) text[i++] = '\n';
+    depth ++;
+  }
+  return text;
+}
+
+/* (* ... *) banners; the text after each opening "(*" is the comment body.
+ * Only whole banners are written, the rest of the buffer is blank. */
+char *makeComments(size_t size) {
+  static const char banner[] =
+    "(*****************************************************************\n"
+    " *  Generated procedure, do not edit. Stray ) and * characters   *\n"
+    " *  keep the terminator search honest: * ) (* **                 *\n"
+    " *****************************************************************)\n";
+  char *text = (char*) malloc(size);
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    text[i] = banner[i % (sizeof(banner) - 1)];
+  for (i = size - size % (sizeof(banner) - 1); i < size; i++)
+    text[i] = ' ';
+  return text;
+}
+
+/* Identifiers, keywords and numbers separated by single blanks */
+char *makeWords(size_t size) {
+  static const char *words[] = {
+    "i", "counter", "BEGIN", "x1", "0", "42", "readInteger", "END", "n",
+    "1000000", "tmp", "WHILE", "DO", "sumOfSquares", "7", "A", "result"
+  };
+  char *text = (char*) malloc(size);
+  size_t i = 0;
+  int w = 0;
+
+  while (i < size) {
+    const char *word = words[w++ % (sizeof(words) / sizeof(words[0]))];
+    size_t n = strlen(word);
+    if (i + n + 1 > size) break;
+    memcpy(text + i, word, n);
+    text[i + n] = ' ';
+    i += n + 1;
+  }
+  memset(text + i, ' ', size - i);
+  return text;
+}
+
+/* Statements with char constants, interleaved with comments that run
+ * over several lines and hold code-like text, quotes and stray brackets,
+ * so that the chunks of the parallel lexer start inside them */
+char *makeProgram(size_t size) {
+  static const char *lines[] = {
+    "  x := x + 1; c := 'a';\n",
+    "  (* a comment over lines\n",
+    "     BEGIN y := 'q'; ( * ) *\n",
+    "     END; *)\n",
+    "  IF n > 42 THEN CALL WRITEC(')');\n",
+    "  (* one line, with a quote ' in it *)\n",
+    "  sumOfSquares := sumOfSquares + i * i;\n"
+  };
+  char *text = (char*) malloc(size);
+  size_t i = 0;
+  int l = 0;
+
+  while (i < size) {
+    const char *line = lines[l++ % (sizeof(lines) / sizeof(lines[0]))];
+    size_t n = strlen(line);
+    if (i + n > size) break;
+    memcpy(text + i, line, n);
+    i += n;
+  }
+  memset(text + i, ' ', size - i);
+  return text;
+}
+
+void oldSkipBlank(Scanner *scanner) {
+  while ((scanner->currentChar != EOF) && (charCodes[scanner->currentChar] == CHAR_SPACE))
+    readChar(scanner);
+}
+
+void oldSkipComment(Scanner *scanner) {
+  int state = 0;
+  while ((scanner->currentChar != EOF) && (state < 2)) {
+    switch (charCodes[scanner->currentChar]) {
+    case CHAR_TIMES:
+      state = 1;
+      break;
+    case CHAR_RPAR:
+      if (state == 1) state = 2;
+      else state = 0;
+      break;
+    default:
+      state = 0;
+    }
+    readChar(scanner);
+  }
+}
+
+Token* oldReadIdentKeyword(Scanner *scanner) {
+  Token *token = makeToken(TK_NONE, currentOffset(scanner));
+  int count = 1;
+
+  token->string[0] = toupper((char)scanner->currentChar);
+  readChar(scanner);
+
+  while ((scanner->currentChar != EOF) &&
+	 ((charCodes[scanner->currentChar] == CHAR_LETTER) || (charCodes[scanner->currentChar] == CHAR_DIGIT))) {
+    if (count <= MAX_IDENT_LEN) token->string[count++] = toupper((char)scanner->currentChar);
+    readChar(scanner);
+  }
+
+  token->string[count] = '\0';
+  token->tokenType = checkKeyword(token->string);
+  if (token->tokenType == TK_NONE)
+    token->tokenType = TK_IDENT;
+  return token;
+}
+
+Token* oldReadNumber(Scanner *scanner) {
+  Token *token = makeToken(TK_NUMBER, currentOffset(scanner));
+  int count = 0;
+
+  while ((scanner->currentChar != EOF) && (charCodes[scanner->currentChar] == CHAR_DIGIT)) {
+    token->string[count++] = (char)scanner->currentChar;
+    readChar(scanner);
+  }
+
+  token->string[count] = '\0';
+  token->value = atoi(token->string);
+  return token;
+}
+
+/* Walks the whole text, skipping blanks with skip and stepping over
+ * everything else one character at a time */
+void runBlanks(const char *text, size_t size, void (*skip)(Scanner*)) {
+  Scanner source, *scanner = &source;
+
+  openInputMemory(scanner, text, size);
+  while (scanner->currentChar != EOF) {
+    if (charCodes[scanner->currentChar] == CHAR_SPACE) skip(scanner);
+    else readChar(scanner);
+  }
+  closeInputStream(scanner);
+}
+
+/* Walks the whole text, skipping a comment body after every "(*" */
+void runComments(const char *text, size_t size, void (*skip)(Scanner*)) {
+  Scanner source, *scanner = &source;
+
+  openInputMemory(scanner, text, size);
+  while (scanner->currentChar != EOF) {
+    if (scanner->currentChar == '(') {
+      readChar(scanner);
+      if (scanner->currentChar == '*') {
+        readChar(scanner);
+        skip(scanner);
+      }
+    } else readChar(scanner);
+  }
+  closeInputStream(scanner);
+}
+
+/* The current readers, into a fresh token each time like the old ones */
+Token* allocReadIdentKeyword(Scanner *scanner) {
+  return readIdentKeyword(scanner, (Token*) malloc(sizeof(Token)));
+}
+
+Token* allocReadNumber(Scanner *scanner) {
+  return readNumber(scanner, (Token*) malloc(sizeof(Token)));
+}
+
+/* Reads every identifier and number with the given functions */
+void runWords(const char *text, size_t size, Token* (*readIdent)(Scanner*), Token* (*readNum)(Scanner*)) {
+  Scanner source, *scanner = &source;
+
+  openInputMemory(scanner, text, size);
+  while (scanner->currentChar != EOF) {
+    if (charCodes[scanner->currentChar] == CHAR_LETTER) free(readIdent(scanner));
+    else if (charCodes[scanner->currentChar] == CHAR_DIGIT) free(readNum(scanner));
+    else readChar(scanner);
+  }
+  closeInputStream(scanner);
+}
+
+void measureWords(char *name, const char *text, size_t size,
+                  Token* (*readIdent)(Scanner*), Token* (*readNum)(Scanner*)) {
+  double best = 0;
+  int round;
+
+  for (round = 0; round < BENCH_ROUNDS; round ++) {
+    double start = now(), elapsed;
+    runWords(text, size, readIdent, readNum);
+    elapsed = now() - start;
+    if ((best == 0) || (elapsed < best)) best = elapsed;
+  }
+  printf("  %-28s %9.1f MB/s\n", name, size / best / 1e6);
+}
+
+/* Scans the whole text into malloc'ed tokens, or in place into a ring */
+void runTokens(const char *text, size_t size, int inPlace) {
+  Scanner source, *scanner = &source;
+  Token ring[16];
+  int slot = 0;
+
+  openInputMemory(scanner, text, size);
+  if (inPlace) {
+    while (readValidToken(scanner, &ring[slot])->tokenType != TK_EOF)
+      slot = (slot + 1) & 15;
+  } else {
+    Token *token;
+    while ((token = getValidToken(scanner))->tokenType != TK_EOF)
+      free(token);
+    free(token);
+  }
+  closeInputStream(scanner);
+}
+
+/* Lexes the whole text into a TokenStream, in parallel unless threads
+ * is 1; returns the token count */
+int runStream(const char *text, size_t size, int threads) {
+  Scanner source, *scanner = &source;
+  TokenStream *stream;
+  int count;
+
+  openInputMemory(scanner, text, size);
+  if (threads == 1) stream = tokenizeInput(scanner);
+  else stream = tokenizeInputParallel(scanner, threads);
+  count = stream->count;
+  freeTokenStream(stream);
+  closeInputStream(scanner);
+  return count;
+}
+
+void measureStream(char *name, const char *text, size_t size, int threads) {
+  double best = 0;
+  int round, count = 0;
+
+  for (round = 0; round < BENCH_ROUNDS; round ++) {
+    double start = now(), elapsed;
+    count = runStream(text, size, threads);
+    elapsed = now() - start;
+    if ((best == 0) || (elapsed < best)) best = elapsed;
+  }
+  printf("  %-28s %9.1f MB/s %7.1f Mtokens/s\n", name, size / best / 1e6, count / best / 1e6);
+}
+
+/* Edits one byte in the middle of a pre-tokenized text, first in place
+ * and then by inserting it, and re-lexes after each edit */
+void measureRelex(char *name, const char *text, size_t size) {
+  Scanner source, *scanner = &source;
+  TokenStream *stream;
+  char *copy = (char*) malloc(size + 1);
+  size_t middle = size / 2;
+  double start, replaced, grown;
+  int round;
+
+  memcpy(copy, text, size);
+  while ((middle < size) && (charCodes[(unsigned char) copy[middle]] != CHAR_LETTER))
+    middle ++;
+  openInputMemory(scanner, copy, size);
+  stream = tokenizeInput(scanner);
+
+  start = now();
+  for (round = 0; round < BENCH_ROUNDS; round ++) {
+    copy[middle] ^= 'a' ^ 'b';
+    relexTokenStream(stream, copy, size, middle, 1, 1, NULL);
+  }
+  replaced = (now() - start) / BENCH_ROUNDS;
+
+  memmove(copy + middle + 1, copy + middle, size - middle);
+  start = now();
+  relexTokenStream(stream, copy, size + 1, middle, 0, 1, NULL);
+  grown = now() - start;
+
+  printf("  %-28s %9.1f us replacing, %.1f us inserting a byte\n", name, replaced * 1e6, grown * 1e6);
+  freeTokenStream(stream);
+  closeInputStream(scanner);
+  free(copy);
+}
+
+/* Compares got with the stream tokenizeInput made of the same text:
+ * the types, offsets and lengths of the tokens, their values, which
+ * hold the atoms of identifiers, and the error lexing stopped at. The
+ * first difference is printed. */
+int sameTokens(char *name, TokenStream *got, TokenStream *expected) {
+  int i;
+
+  for (i = 0; (i < got->count) && (i < expected->count); i++)
+    if ((got->types[i] != expected->types[i]) || (got->offsets[i] != expected->offsets[i]) ||
+        (got->lengths[i] != expected->lengths[i]) || (got->values[i] != expected->values[i])) {
+      printf("  %s: token %d differs\n", name, i);
+      printf("    got      type %d at %u, length %d, value %u\n", got->types[i],
+             (unsigned) got->offsets[i], got->lengths[i], got->values[i]);
+      printf("    expected type %d at %u, length %d, value %u\n", expected->types[i],
+             (unsigned) expected->offsets[i], expected->lengths[i], expected->values[i]);
+      return 0;
+    }
+  if (got->count != expected->count) {
+    printf("  %s: %d tokens, expected %d\n", name, got->count, expected->count);
+    return 0;
+  }
+  if ((got->failed != expected->failed) ||
+      (got->failed && ((got->diagnostic.offset != expected->diagnostic.offset) ||
+                       (strcmp(got->diagnostic.message, expected->diagnostic.message) != 0)))) {
+    printf("  %s: lexing stopped\n", name);
+    printf("    got      %s at %u\n", got->failed ? got->diagnostic.message : "at the end",
+           (unsigned) got->diagnostic.offset);
+    printf("    expected %s at %u\n", expected->failed ? expected->diagnostic.message : "at the end",
+           (unsigned) expected->diagnostic.offset);
+    return 0;
+  }
+  return 1;
+}
+
+/* Checks tokenizeInputParallel against tokenizeInput, with 2 to
+ * MAX_CHECK_THREADS threads whatever the number of processors, so that
+ * the chunks are cut in different places */
+int checkParallel(char *name, const char *text, size_t size) {
+  Scanner source, *scanner = &source;
+  TokenStream *got, *expected;
+  char label[64];
+  int threads, result = 1;
+
+  openInputMemory(scanner, text, size);
+  expected = tokenizeInput(scanner);
+  closeInputStream(scanner);
+
+  for (threads = 2; (threads <= MAX_CHECK_THREADS) && result; threads++) {
+    openInputMemory(scanner, text, size);
+    got = tokenizeInputParallel(scanner, threads);
+    closeInputStream(scanner);
+    snprintf(label, sizeof(label), "%s, %d threads", name, threads);
+    result = sameTokens(label, got, expected);
+    freeTokenStream(got);
+  }
+
+  if (result)
+    printf("  %-28s ok, %d tokens\n", name, expected->count);
+  freeTokenStream(expected);
+  return result;
+}
+
+/* Makes random edits to a small program, re-lexes after each and checks
+ * the stream against the edited text lexed from scratch. Most edits put
+ * in or take out comment brackets and quotes, so that comments and char
+ * constants open and close across them. */
+int checkRelex(char *name, int edits) {
+  static const char *pieces[] = {
+    "(*", "*)", "'", "'a'", "(* x *)", "*", "(", ")", "x", "BEGIN", "12", " ", "\n", ":=", ";"
+  };
+  Scanner source, *scanner = &source;
+  TokenStream *stream, *expected;
+  char *text = (char*) malloc(2 * CHECK_TEXT_SIZE);
+  char label[64];
+  size_t size = CHECK_TEXT_SIZE, offset, removed, inserted;
+  const char *piece;
+  int i, result = 1;
+
+  piece = makeProgram(CHECK_TEXT_SIZE);
+  memcpy(text, piece, CHECK_TEXT_SIZE);
+  free((char*) piece);
+  openInputMemory(scanner, text, size);
+  stream = tokenizeInput(scanner);
+  closeInputStream(scanner);
+
+  srand(1);
+  for (i = 0; (i < edits) && result; i++) {
+    offset = rand() % (size + 1);
+    removed = rand() % 4;
+    if ((offset + removed > size) || (size - removed < CHECK_TEXT_SIZE / 2))
+      removed = 0;
+    piece = (rand() % 4 == 0) ? "" : pieces[rand() % (sizeof(pieces) / sizeof(pieces[0]))];
+    inserted = strlen(piece);
+    if (size - removed + inserted > 2 * CHECK_TEXT_SIZE)
+      inserted = 0;
+
+    memmove(text + offset + inserted, text + offset + removed, size - offset - removed);
+    memcpy(text + offset, piece, inserted);
+    size = size - removed + inserted;
+    relexTokenStream(stream, text, size, offset, removed, inserted, NULL);
+
+    openInputMemory(scanner, text, size);
+    expected = tokenizeInput(scanner);
+    closeInputStream(scanner);
+    snprintf(label, sizeof(label), "%s, edit %d at %zu", name, i, offset);
+    result = sameTokens(label, stream, expected);
+    freeTokenStream(expected);
+  }
+
+  if (result)
+    printf("  %-28s ok, %d edits\n", name, edits);
+  freeTokenStream(stream);
+  free(text);
+  return result;
+}
+
+void measureTokens(char *name, const char *text, size_t size, int inPlace) {
+  double best = 0;
+  int round;
+
+  for (round = 0; round < BENCH_ROUNDS; round ++) {
+    double start = now(), elapsed;
+    runTokens(text, size, inPlace);
+    elapsed = now() - start;
+    if ((best == 0) || (elapsed < best)) best = elapsed;
+  }
+  printf("  %-28s %9.1f MB/s\n", name, size / best / 1e6);
+}
+
+void measure(char *name, void (*run)(const char*, size_t, void (*)(Scanner*)),
+             const char *text, size_t size, void (*skip)(Scanner*)) {
+  double best = 0;
+  int round;
+
+  for (round = 0; round < BENCH_ROUNDS; round ++) {
+    double start = now(), elapsed;
+    run(text, size, skip);
+    elapsed = now() - start;
+    if ((best == 0) || (elapsed < best)) best = elapsed;
+  }
+  printf("  %-28s %9.1f MB/s\n", name, size / best / 1e6);
+}
+
+void measureKernels(char *name, ScanKernel space, ScanKernel comment,
+                    const char *blanks, const char *comments, size_t size) {
+  char label[64];
+
+  spaceKernel = space;
+  commentKernel = comment;
+  snprintf(label, sizeof(label), "skipBlank, %s", name);
+  measure(label, runBlanks, blanks, size, skipBlank);
+  snprintf(label, sizeof(label), "skipComment, %s", name);
+  measure(label, runComments, comments, size, skipComment);
+}
+
+int main(void) {
+  size_t size = BENCH_SIZE;
+  char *blanks = makeIndented(size);
+  char *comments = makeComments(size);
+  char *words = makeWords(size);
+  char *program = makeProgram(size);
+  int failed = 0;
+
+  printf("token streams against tokenizeInput, %zu MB inputs\n", size >> 20);
+  failed |= !checkParallel("lexed in parallel, words", words, size);
+  failed |= !checkParallel("lexed in parallel, program", program, size);
+  failed |= !checkParallel("lexed in parallel, comments", comments, size);
+  failed |= !checkRelex("re-lexed after edits", CHECK_EDITS);
+  if (failed) {
+    printf("token streams differ, nothing measured\n");
+    return -1;
+  }
+
+  printf("whitespace and comment skipping, %zu MB inputs\n", size >> 20);
+  measure("skipBlank, readChar loop", runBlanks, blanks, size, oldSkipBlank);
+  measure("skipComment, readChar loop", runComments, comments, size, oldSkipComment);
+  measureKernels("scalar", skipSpaceRunScalar, findCommentEndScalar, blanks, comments, size);
+#ifdef __SSE2__
+  measureKernels("SSE2", skipSpaceRunSSE2, findCommentEndSSE2, blanks, comments, size);
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    measureKernels("AVX2", skipSpaceRunAVX2, findCommentEndAVX2, blanks, comments, size);
+#endif
+
+  printf("identifier and number runs, %zu MB input\n", size >> 20);
+  measureWords("readChar loop", words, size, oldReadIdentKeyword, oldReadNumber);
+  measureWords("run kernels", words, size, allocReadIdentKeyword, allocReadNumber);
+
+  printf("token stream, %zu MB input\n", size >> 20);
+  measureTokens("malloc per token", words, size, 0);
+  measureTokens("token ring", words, size, 1);
+  measureStream("pre-tokenized stream", words, size, 1);
+  measureStream("lexed in parallel", words, size, 0);
+  measureRelex("re-lexed after an edit", words, size);
+
+  free(program);
+  free(words);
+  free(blanks);
+  free(comments);
+  return 0;
+}
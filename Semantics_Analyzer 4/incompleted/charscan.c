@@ -0,0 +1,229 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stddef.h>
+#include "charcode.h"
+#include "charscan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNELS
+#endif
+
+extern const CharCode charCodes[];
+
+/* CHAR_SPACE is ' ' and '\t' .. '\r' */
+
+const char *skipSpaceRunScalar(const char *p, const char *limit) {
+  while ((p < limit) && (charCodes[(unsigned char) *p] == CHAR_SPACE))
+    p ++;
+  return p;
+}
+
+const char *findCommentEndScalar(const char *p, const char *limit) {
+  for (; p + 1 < limit; p ++)
+    if ((p[0] == '*') && (p[1] == ')'))
+      return p;
+  return NULL;
+}
+
+#ifdef __SSE2__
+
+const char *skipSpaceRunSSE2(const char *p, const char *limit) {
+  const __m128i blank = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i four = _mm_set1_epi8(4);
+
+  for (; p + 16 <= limit; p += 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i*) p);
+    __m128i control = _mm_sub_epi8(chunk, tab);
+    __m128i space = _mm_or_si128(_mm_cmpeq_epi8(chunk, blank),
+                                 _mm_cmpeq_epi8(_mm_min_epu8(control, four), control));
+    unsigned mask = ~_mm_movemask_epi8(space) & 0xFFFF;
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+  }
+  return skipSpaceRunScalar(p, limit);
+}
+
+const char *findCommentEndSSE2(const char *p, const char *limit) {
+  const __m128i star = _mm_set1_epi8('*');
+  const __m128i rpar = _mm_set1_epi8(')');
+
+  for (; p + 17 <= limit; p += 16) {
+    __m128i here = _mm_loadu_si128((const __m128i*) p);
+    __m128i next = _mm_loadu_si128((const __m128i*) (p + 1));
+    unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(here, star),
+                                                    _mm_cmpeq_epi8(next, rpar)));
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+  }
+  return findCommentEndScalar(p, limit);
+}
+
+#endif
+
+#ifdef HAVE_AVX2_KERNELS
+
+__attribute__((target("avx2")))
+const char *skipSpaceRunAVX2(const char *p, const char *limit) {
+  const __m256i blank = _mm256_set1_epi8(' ');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i four = _mm256_set1_epi8(4);
+
+  for (; p + 32 <= limit; p += 32) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i*) p);
+    __m256i control = _mm256_sub_epi8(chunk, tab);
+    __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, blank),
+                                    _mm256_cmpeq_epi8(_mm256_min_epu8(control, four), control));
+    unsigned mask = ~(unsigned) _mm256_movemask_epi8(space);
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+  }
+  return skipSpaceRunScalar(p, limit);
+}
+
+__attribute__((target("avx2")))
+const char *findCommentEndAVX2(const char *p, const char *limit) {
+  const __m256i star = _mm256_set1_epi8('*');
+  const __m256i rpar = _mm256_set1_epi8(')');
+
+  for (; p + 33 <= limit; p += 32) {
+    __m256i here = _mm256_loadu_si256((const __m256i*) p);
+    __m256i next = _mm256_loadu_si256((const __m256i*) (p + 1));
+    unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(here, star),
+                                                          _mm256_cmpeq_epi8(next, rpar)));
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+  }
+  return findCommentEndScalar(p, limit);
+}
+
+#endif
+
+/******************************************************************/
+
+/* Identifier and number runs are short, so one 16-byte step usually
+ * covers the whole run and there is nothing to gain from AVX2 here. */
+
+#ifdef __SSE2__
+
+/* Mask of the bytes of chunk that are letters or digits */
+static inline unsigned wordMask(__m128i chunk) {
+  __m128i folded = _mm_sub_epi8(_mm_or_si128(chunk, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+  __m128i digit = _mm_sub_epi8(chunk, _mm_set1_epi8('0'));
+  __m128i letters = _mm_cmpeq_epi8(_mm_min_epu8(folded, _mm_set1_epi8(25)), folded);
+  __m128i digits = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+  return _mm_movemask_epi8(_mm_or_si128(letters, digits));
+}
+
+static inline unsigned digitMask(__m128i chunk) {
+  __m128i digit = _mm_sub_epi8(chunk, _mm_set1_epi8('0'));
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit));
+}
+
+#endif
+
+const char *skipWordRun(const char *p, const char *limit) {
+#ifdef __SSE2__
+  for (; p + 16 <= limit; p += 16) {
+    unsigned mask = ~wordMask(_mm_loadu_si128((const __m128i*) p)) & 0xFFFF;
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+  }
+#endif
+  while ((p < limit) && ((charCodes[(unsigned char) *p] == CHAR_LETTER) ||
+                         (charCodes[(unsigned char) *p] == CHAR_DIGIT)))
+    p ++;
+  return p;
+}
+
+const char *skipDigitRun(const char *p, const char *limit) {
+#ifdef __SSE2__
+  for (; p + 16 <= limit; p += 16) {
+    unsigned mask = ~digitMask(_mm_loadu_si128((const __m128i*) p)) & 0xFFFF;
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+  }
+#endif
+  while ((p < limit) && (charCodes[(unsigned char) *p] == CHAR_DIGIT))
+    p ++;
+  return p;
+}
+
+void copyUpper(char *dst, const char *src, int n, const char *limit) {
+  int i;
+
+#ifdef __SSE2__
+  if (src + 16 <= limit) {
+    const __m128i index = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i chunk = _mm_loadu_si128((const __m128i*) src);
+    __m128i lower = _mm_sub_epi8(chunk, _mm_set1_epi8('a'));
+    __m128i isLower = _mm_cmpeq_epi8(_mm_min_epu8(lower, _mm_set1_epi8(25)), lower);
+    __m128i inRun = _mm_cmplt_epi8(index, _mm_set1_epi8((char) n));
+    chunk = _mm_sub_epi8(chunk, _mm_and_si128(isLower, _mm_set1_epi8(0x20)));
+    _mm_storeu_si128((__m128i*) dst, _mm_and_si128(chunk, inRun));
+    return;
+  }
+#endif
+  for (i = 0; i < n; i++)
+    dst[i] = ((src[i] >= 'a') && (src[i] <= 'z')) ? src[i] - 0x20 : src[i];
+  for (; i < 16; i++)
+    dst[i] = '\0';
+}
+
+/******************************************************************/
+
+typedef const char *(*ScanKernel)(const char *p, const char *limit);
+
+const char *skipSpaceRunFirst(const char *p, const char *limit);
+const char *findCommentEndFirst(const char *p, const char *limit);
+
+ScanKernel spaceKernel = skipSpaceRunFirst;
+ScanKernel commentKernel = findCommentEndFirst;
+
+/* Picks the kernels on first use. Threads may race to do so; they all
+ * store the same pointers, so relaxed atomics are enough. */
+void selectKernels(void) {
+  ScanKernel space, comment;
+
+#ifdef HAVE_AVX2_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    space = skipSpaceRunAVX2;
+    comment = findCommentEndAVX2;
+  } else
+#endif
+  {
+#ifdef __SSE2__
+    space = skipSpaceRunSSE2;
+    comment = findCommentEndSSE2;
+#else
+    space = skipSpaceRunScalar;
+    comment = findCommentEndScalar;
+#endif
+  }
+  __atomic_store_n(&spaceKernel, space, __ATOMIC_RELAXED);
+  __atomic_store_n(&commentKernel, comment, __ATOMIC_RELAXED);
+}
+
+const char *skipSpaceRunFirst(const char *p, const char *limit) {
+  selectKernels();
+  return skipSpaceRun(p, limit);
+}
+
+const char *findCommentEndFirst(const char *p, const char *limit) {
+  selectKernels();
+  return findCommentEnd(p, limit);
+}
+
+const char *skipSpaceRun(const char *p, const char *limit) {
+  return __atomic_load_n(&spaceKernel, __ATOMIC_RELAXED)(p, limit);
+}
+
+const char *findCommentEnd(const char *p, const char *limit) {
+  return __atomic_load_n(&commentKernel, __ATOMIC_RELAXED)(p, limit);
+}
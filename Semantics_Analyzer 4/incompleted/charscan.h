@@ -0,0 +1,34 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __CHARSCAN_H__
+#define __CHARSCAN_H__
+
+/* Block scanning kernels used by the scanner to jump over whitespace,
+ * comment bodies and identifier or number runs. Each one works on [p, limit) only, so callers handle
+ * chunk boundaries of streamed input themselves. The whitespace and
+ * comment kernels use AVX2 when the processor has it; everything else
+ * uses SSE2, with plain loops off x86. */
+
+/* First byte in [p, limit) that is not CHAR_SPACE, or limit */
+const char *skipSpaceRun(const char *p, const char *limit);
+
+/* First '*' in [p, limit) that is directly followed by ')', or NULL.
+ * A '*' in the last byte is never reported since its ')' is not visible. */
+const char *findCommentEnd(const char *p, const char *limit);
+
+/* First byte in [p, limit) that is neither CHAR_LETTER nor CHAR_DIGIT,
+ * or limit */
+const char *skipWordRun(const char *p, const char *limit);
+
+/* First byte in [p, limit) that is not CHAR_DIGIT, or limit */
+const char *skipDigitRun(const char *p, const char *limit);
+
+/* Stores 16 bytes at dst: the n (at most 16) letters and digits at src
+ * in upper case, then zeros. limit bounds the bytes readable at src. */
+void copyUpper(char *dst, const char *src, int n, const char *limit);
+
+#endif
@@ -0,0 +1,45 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __CONTEXT_H__
+#define __CONTEXT_H__
+
+#include "reader.h"
+#include "token.h"
+#include "tokstream.h"
+#include "symtab.h"
+#include "ast.h"
+
+/* Capacity of the parser's token ring, a power of two. One slot holds
+ * currentToken, so up to TOKEN_RING_SIZE - 1 tokens can be looked at ahead. */
+#define TOKEN_RING_SIZE 16
+
+/* Everything one compilation works on. The parser and the semantic
+ * checks keep no state of their own, so compilations on different
+ * threads, each with its context, do not get in each other's way. */
+typedef struct {
+  Scanner *scanner;             /* the input being compiled */
+
+  /* Tokens are scanned in place into a ring. currentToken and lookAhead
+   * point at two neighbouring slots; the slots after lookAhead hold
+   * tokens already scanned by peekToken. */
+  Token tokenRing[TOKEN_RING_SIZE];
+  int ringHead;                 /* slot of lookAhead */
+  int ringFilled;               /* tokens scanned so far, starting with lookAhead */
+  Token *currentToken;
+  Token *lookAhead;
+
+  /* The whole input lexed up front, when it is, which fills the ring
+   * instead of the scanner */
+  TokenStream *tokenStream;
+  int streamNext;               /* index in tokenStream of the next token to unpack */
+
+  AtomTable *atoms;             /* the names of the input */
+  SymTab *symtab;
+  Ast *ast;                     /* the tree of the program, while one is built */
+} CompileContext;
+
+#endif
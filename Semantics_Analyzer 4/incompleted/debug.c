@@ -5,25 +5,44 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include "debug.h"
 
+/* Tree levels indented by printAst; nodes deeper than that are printed
+ * at this indentation with their depth */
+#define MAX_AST_INDENT 16
+
+/* Per thread, like the error state, so that threads dump on their own */
+__thread FILE *debugOutput = NULL;
+
+void setDebugOutput(FILE *f) {
+  debugOutput = f;
+}
+
+FILE *debugStream(void) {
+  return (debugOutput != NULL) ? debugOutput : stdout;
+}
+
 void pad(int n) {
   int i;
-  for (i = 0; i < n ; i++) printf(" ");
+  for (i = 0; i < n ; i++) fprintf(debugStream(), " ");
 }
 
 void printType(Type* type) {
   switch (type->typeClass) {
   case TP_INT:
-    printf("Int");
+    fprintf(debugStream(), "Int");
     break;
   case TP_CHAR:
-    printf("Char");
+    fprintf(debugStream(), "Char");
     break;
   case TP_ARRAY:
-    printf("Arr(%d,",type->arraySize);
+    fprintf(debugStream(), "Arr(%d,",type->arraySize);
     printType(type->elementType);
-    printf(")");
+    fprintf(debugStream(), ")");
+    break;
+  case TP_ERROR:
+    fprintf(debugStream(), "Error");
     break;
   }
 }
@@ -31,10 +50,10 @@ void printType(Type* type) {
 void printConstantValue(ConstantValue* value) {
   switch (value->type) {
   case TP_INT:
-    printf("%d",value->intValue);
+    fprintf(debugStream(), "%d",value->intValue);
     break;
   case TP_CHAR:
-    printf("\'%c\'",value->charValue);
+    fprintf(debugStream(), "\'%c\'",value->charValue);
     break;
   default:
     break;
@@ -45,42 +64,42 @@ void printObject(Object* obj, int indent) {
   switch (obj->kind) {
   case OBJ_CONSTANT:
     pad(indent);
-    printf("Const %s = ", obj->name);
+    fprintf(debugStream(), "Const %s = ", atomName(obj->name));
     printConstantValue(obj->constAttrs->value);
     break;
   case OBJ_TYPE:
     pad(indent);
-    printf("Type %s = ", obj->name);
+    fprintf(debugStream(), "Type %s = ", atomName(obj->name));
     printType(obj->typeAttrs->actualType);
     break;
   case OBJ_VARIABLE:
     pad(indent);
-    printf("Var %s : ", obj->name);
+    fprintf(debugStream(), "Var %s : ", atomName(obj->name));
     printType(obj->varAttrs->type);
     break;
   case OBJ_PARAMETER:
     pad(indent);
     if (obj->paramAttrs->kind == PARAM_VALUE) 
-      printf("Param %s : ", obj->name);
+      fprintf(debugStream(), "Param %s : ", atomName(obj->name));
     else
-      printf("Param VAR %s : ", obj->name);
+      fprintf(debugStream(), "Param VAR %s : ", atomName(obj->name));
     printType(obj->paramAttrs->type);
     break;
   case OBJ_FUNCTION:
     pad(indent);
-    printf("Function %s : ",obj->name);
+    fprintf(debugStream(), "Function %s : ",atomName(obj->name));
     printType(obj->funcAttrs->returnType);
-    printf("\n");
+    fprintf(debugStream(), "\n");
     printScope(obj->funcAttrs->scope, indent + 4);
     break;
   case OBJ_PROCEDURE:
     pad(indent);
-    printf("Procedure %s\n",obj->name);
+    fprintf(debugStream(), "Procedure %s\n",atomName(obj->name));
     printScope(obj->procAttrs->scope, indent + 4);
     break;
   case OBJ_PROGRAM:
     pad(indent);
-    printf("Program %s\n",obj->name);
+    fprintf(debugStream(), "Program %s\n",atomName(obj->name));
     printScope(obj->progAttrs->scope, indent + 4);
     break;
   }
@@ -90,7 +109,7 @@ void printObjectList(ObjectNode* objList, int indent) {
   ObjectNode *node = objList;
   while (node != NULL) {
     printObject(node->object, indent);
-    printf("\n");
+    fprintf(debugStream(), "\n");
     node = node->next;
   }
 }
@@ -99,3 +118,138 @@ void printScope(Scope* scope, int indent) {
   printObjectList(scope->objList, indent);
 }
 
+
+const char *nodeKindName(NodeKind kind) {
+  switch (kind) {
+  case AST_PROGRAM: return "Program";
+  case AST_BLOCK: return "Block";
+  case AST_CONST_DECL: return "Const";
+  case AST_TYPE_DECL: return "Type";
+  case AST_VAR_DECL: return "Var";
+  case AST_FUNC_DECL: return "Function";
+  case AST_PROC_DECL: return "Procedure";
+  case AST_PARAM: return "Param";
+  case AST_INT_TYPE: return "Int";
+  case AST_CHAR_TYPE: return "Char";
+  case AST_ARRAY_TYPE: return "Arr";
+  case AST_NAMED_TYPE: return "TypeName";
+  case AST_EMPTY: return "Empty";
+  case AST_ASSIGN: return "Assign";
+  case AST_GROUP: return "Group";
+  case AST_IF: return "If";
+  case AST_WHILE: return "While";
+  case AST_FOR: return "For";
+  case AST_CALL: return "Call";
+  case AST_COMPARE: return "Compare";
+  case AST_UNARY: return "Unary";
+  case AST_BINARY: return "Binary";
+  case AST_NUMBER: return "Number";
+  case AST_CHAR: return "CharConst";
+  case AST_NAME: return "Name";
+  case AST_INDEX: return "Index";
+  case AST_ERROR: return "Error";
+  }
+  return "?";
+}
+
+const char *operatorName(TokenType op) {
+  switch (op) {
+  case SB_EQ: return "=";
+  case SB_NEQ: return "!=";
+  case SB_LT: return "<";
+  case SB_LE: return "<=";
+  case SB_GT: return ">";
+  case SB_GE: return ">=";
+  case SB_PLUS: return "+";
+  case SB_MINUS: return "-";
+  case SB_TIMES: return "*";
+  case SB_SLASH: return "/";
+  default: return "?";
+  }
+}
+
+void printAstNode(Ast* ast, NodeIndex index, uint32_t depth, Scanner *source) {
+  AstNode *node = &ast->nodes[index];
+  int lineNo, colNo;
+
+  if (depth <= MAX_AST_INDENT) pad(4 * depth);
+  else {
+    pad(4 * MAX_AST_INDENT);
+    fprintf(debugStream(), "[%u] ", (unsigned int) depth);
+  }
+  fprintf(debugStream(), "%s", nodeKindName(node->kind));
+  switch (node->kind) {
+  case AST_PROGRAM:
+  case AST_CONST_DECL:
+  case AST_TYPE_DECL:
+  case AST_VAR_DECL:
+  case AST_FUNC_DECL:
+  case AST_PROC_DECL:
+  case AST_NAMED_TYPE:
+  case AST_FOR:
+  case AST_CALL:
+  case AST_NAME:
+  case AST_INDEX:
+    fprintf(debugStream(), " %s", atomName(node->value));
+    break;
+  case AST_PARAM:
+    fprintf(debugStream(), " %s%s", (node->op == PARAM_REFERENCE) ? "VAR " : "", atomName(node->value));
+    break;
+  case AST_ARRAY_TYPE:
+    fprintf(debugStream(), "(%d)", (int) node->value);
+    break;
+  case AST_COMPARE:
+  case AST_UNARY:
+  case AST_BINARY:
+    fprintf(debugStream(), " %s", operatorName(node->op));
+    break;
+  case AST_NUMBER:
+    fprintf(debugStream(), " %d", (int) node->value);
+    break;
+  case AST_CHAR:
+    fprintf(debugStream(), " \'%c\'", (char) node->value);
+    break;
+  default:
+    break;
+  }
+  locateOffset(source, node->offset, &lineNo, &colNo);
+  fprintf(debugStream(), " @%d-%d\n", lineNo, colNo);
+}
+
+/* Walks the tree with a stack of its own rather than by recursion: the
+ * tree of an expression is as deep as the expression is long. Every
+ * node is pushed once, so the stack never holds more than the arena. */
+void printAst(Ast* ast, Scanner *source) {
+  NodeIndex *nodes;
+  uint32_t *depths;
+  uint32_t top = 0, depth, i;
+  AstNode *node;
+
+  if (ast->root == 0)
+    return;
+  nodes = (NodeIndex*) malloc(ast->nodeCount * sizeof(NodeIndex));
+  depths = (uint32_t*) malloc(ast->nodeCount * sizeof(uint32_t));
+  if ((nodes == NULL) || (depths == NULL)) {
+    free(nodes);
+    free(depths);
+    return;
+  }
+
+  nodes[top] = ast->root;
+  depths[top ++] = 0;
+  while (top > 0) {
+    top --;
+    node = &ast->nodes[nodes[top]];
+    depth = depths[top];
+    printAstNode(ast, nodes[top], depth, source);
+
+    // the first child on top, so that children come out in order
+    for (i = node->count; i > 0; i--) {
+      nodes[top] = node->first + i - 1;
+      depths[top ++] = depth + 1;
+    }
+  }
+
+  free(nodes);
+  free(depths);
+}
@@ -7,12 +7,21 @@
 #ifndef __DEBUG_H__
 #define __DEBUG_H_
 
+#include <stdio.h>
 #include "symtab.h"
+#include "ast.h"
+
+void setDebugOutput(FILE *f);
 
 void printType(Type* type);
 void printConstantValue(ConstantValue* value);
 void printObject(Object* obj, int indent);
 void printObjectList(ObjectNode* objList, int indent);
 void printScope(Scope* scope, int indent);
+/* One node a line, its children indented under it, each with its line
+ * and column in source after '@', as diagnostics give them. Below 16
+ * levels the indentation stops growing and each line starts with the
+ * depth of its node in brackets instead. */
+void printAst(Ast* ast, Scanner *source);
 
 #endif
@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "error.h"
 
 #define NUM_OF_ERRORS 30
@@ -17,7 +18,7 @@ struct ErrorMessage {
 
 struct ErrorMessage errors[30] = {
   {ERR_END_OF_COMMENT, "End of comment expected."},
-  {ERR_IDENT_TOO_LONG, "Identifier too long."},
+  {ERR_TOO_MANY_IDENTS, "Too many identifiers."},
   {ERR_INVALID_CONSTANT_CHAR, "Invalid char constant."},
   {ERR_INVALID_SYMBOL, "Invalid symbol."},
   {ERR_INVALID_IDENT, "An identifier expected."},
@@ -48,18 +49,129 @@ struct ErrorMessage errors[30] = {
   {ERR_DIMENSIONAL_OF_ARRAY,"Dimensional error of array"}
 };
 
-void error(ErrorCode err, int lineNo, int colNo) {
+/* All are per thread, so that each thread can compile on its own */
+__thread ErrorTrap *errorTrap = NULL;
+__thread Scanner *errorSource = NULL;
+__thread ErrorLog *errorLog = NULL;
+
+Scanner *setErrorSource(Scanner *scanner) {
+  Scanner *previous = errorSource;
+  errorSource = scanner;
+  return previous;
+}
+
+void armErrorTrap(ErrorTrap *trap) {
+  trap->previous = errorTrap;
+  errorTrap = trap;
+}
+
+void disarmErrorTrap(void) {
+  if (errorTrap != NULL)
+    errorTrap = errorTrap->previous;
+}
+
+void makeDiagnostic(Diagnostic *diagnostic, SourceOffset offset, char *message) {
+  diagnostic->offset = offset;
+  diagnostic->lineNo = 0;
+  diagnostic->colNo = 0;
+  if (errorSource != NULL)
+    locateOffset(errorSource, offset, &diagnostic->lineNo, &diagnostic->colNo);
+  strncpy(diagnostic->message, message, MAX_MESSAGE_LEN - 1);
+  diagnostic->message[MAX_MESSAGE_LEN - 1] = '\0';
+}
+
+void reportError(SourceOffset offset, char *message) {
+  Diagnostic diagnostic;
+
+  if (errorTrap != NULL) {
+    makeDiagnostic(&errorTrap->diagnostic, offset, message);
+    longjmp(errorTrap->env, 1);
+  }
+
+  makeDiagnostic(&diagnostic, offset, message);
+  printf("%d-%d:%s\n", diagnostic.lineNo, diagnostic.colNo, diagnostic.message);
+  exit(0);
+}
+
+void reportDiagnostic(Diagnostic *diagnostic) {
+  reportError(diagnostic->offset, diagnostic->message);
+}
+
+ErrorLog *setErrorLog(ErrorLog *log) {
+  ErrorLog *previous = errorLog;
+  errorLog = log;
+  return previous;
+}
+
+void initErrorLog(ErrorLog *log, int limit) {
+  log->diagnostics = NULL;
+  log->count = 0;
+  log->capacity = 0;
+  log->limit = (limit < 1) ? 1 : limit;
+}
+
+void freeErrorLog(ErrorLog *log) {
+  free(log->diagnostics);
+  log->diagnostics = NULL;
+  log->count = log->capacity = 0;
+}
+
+int sameDiagnostic(Diagnostic *d1, Diagnostic *d2) {
+  return (d1->offset == d2->offset) && (strcmp(d1->message, d2->message) == 0);
+}
+
+void appendDiagnostic(ErrorLog *log, Diagnostic *diagnostic) {
+  if (log->count == log->capacity) {
+    log->capacity = (log->capacity == 0) ? 8 : 2 * log->capacity;
+    log->diagnostics = (Diagnostic*) realloc(log->diagnostics, log->capacity * sizeof(Diagnostic));
+  }
+  log->diagnostics[log->count ++] = *diagnostic;
+}
+
+int logDiagnostic(Diagnostic *diagnostic) {
+  ErrorLog *log = errorLog;
+
+  if ((log == NULL) || (log->count >= log->limit))
+    return 0;
+  if ((log->count > 0) && sameDiagnostic(&log->diagnostics[log->count - 1], diagnostic)) {
+    log->limit = log->count;
+    return 0;
+  }
+  appendDiagnostic(log, diagnostic);
+  return log->count < log->limit;
+}
+
+char *errorMessage(ErrorCode err) {
   int i;
   for (i = 0 ; i < NUM_OF_ERRORS; i ++) 
-    if (errors[i].errorCode == err) {
-      printf("%d-%d:%s\n", lineNo, colNo, errors[i].message);
-      exit(0);
-    }
+    if (errors[i].errorCode == err)
+      return errors[i].message;
+  return "";
 }
 
-void missingToken(TokenType tokenType, int lineNo, int colNo) {
-  printf("%d-%d:Missing %s\n", lineNo, colNo, tokenToString(tokenType));
-  exit(0);
+void error(ErrorCode err, SourceOffset offset) {
+  reportError(offset, errorMessage(err));
+}
+
+void recoverableError(ErrorCode err, SourceOffset offset) {
+  ErrorLog *log = errorLog;
+  Diagnostic diagnostic;
+
+  if ((log == NULL) || (log->count + 1 >= log->limit))
+    reportError(offset, errorMessage(err));
+
+  // the same error twice in a row is only logged once, and only counts
+  // once towards the limit
+  makeDiagnostic(&diagnostic, offset, errorMessage(err));
+  if ((log->count == 0) || !sameDiagnostic(&log->diagnostics[log->count - 1], &diagnostic))
+    appendDiagnostic(log, &diagnostic);
+}
+
+void missingToken(TokenType tokenType, SourceOffset offset) {
+  char message[MAX_MESSAGE_LEN];
+
+  snprintf(message, MAX_MESSAGE_LEN, "Missing %s", tokenToString(tokenType));
+  reportError(offset, message);
 }
 
 void assert(char *msg) {
@@ -6,11 +6,14 @@
 
 #ifndef __ERROR_H__
 #define __ERROR_H__
+#include <setjmp.h>
 #include "token.h"
 
+#define MAX_MESSAGE_LEN 128
+
 typedef enum {
   ERR_END_OF_COMMENT,
-  ERR_IDENT_TOO_LONG,
+  ERR_TOO_MANY_IDENTS,
   ERR_INVALID_CONSTANT_CHAR,
   ERR_INVALID_SYMBOL,
   ERR_INVALID_IDENT,
@@ -41,8 +44,61 @@ typedef enum {
   ERR_DIMENSIONAL_OF_ARRAY
 } ErrorCode;
 
-void error(ErrorCode err, int lineNo, int colNo);
-void missingToken(TokenType tokenType, int lineNo, int colNo);
+typedef struct {
+  SourceOffset offset;
+  int lineNo, colNo;
+  char message[MAX_MESSAGE_LEN];
+} Diagnostic;
+
+/* While a trap is armed, errors are recorded in it and control returns to
+ * the setjmp on env instead of printing and terminating the process.
+ * Traps nest: disarming one re-arms the trap that was armed before it. */
+typedef struct ErrorTrap {
+  jmp_buf env;
+  Diagnostic diagnostic;
+  struct ErrorTrap *previous;
+} ErrorTrap;
+
+/* The errors of one compile, when it goes on after them. limit is how
+ * many may be logged; the compile stops at the one that fills the log.
+ * Only logged errors count towards it: an error at the same offset with
+ * the same message as the one logged last is not logged again. */
+typedef struct {
+  Diagnostic *diagnostics;
+  int count;
+  int capacity;
+  int limit;
+} ErrorLog;
+
+/* Sets the input whose offsets errors refer to, for the calling thread;
+ * returns the one set before */
+Scanner *setErrorSource(Scanner *scanner);
+
+void armErrorTrap(ErrorTrap *trap);
+void disarmErrorTrap(void);
+
+/* Raises an error recorded earlier by a trap, as if it happened now */
+void reportDiagnostic(Diagnostic *diagnostic);
+
+/* Sets the log of the calling thread, or NULL for none; returns the one
+ * set before */
+ErrorLog *setErrorLog(ErrorLog *log);
+void initErrorLog(ErrorLog *log, int limit);
+void freeErrorLog(ErrorLog *log);
+
+/* Adds an error caught by a trap to the log. Returns 0 when compiling
+ * should stop there: there is no log, it is full now, or the error is
+ * the one logged last, which means recovering made no progress. */
+int logDiagnostic(Diagnostic *diagnostic);
+
+void error(ErrorCode err, SourceOffset offset);
+/* Same as error, for errors compiling can go on after without skipping
+ * any input: while the log has room for more than this one, the error is
+ * only logged and the caller carries on. A repeat of the error logged
+ * last is dropped without a word and takes no room in the log, so that
+ * one bad name checked twice in one place is reported once. */
+void recoverableError(ErrorCode err, SourceOffset offset);
+void missingToken(TokenType tokenType, SourceOffset offset);
 void assert(char *msg);
 
 #endif
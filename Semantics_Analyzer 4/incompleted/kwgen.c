@@ -0,0 +1,239 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+/* Build-time generator for the keyword table used by checkKeyword.
+ *
+ * Reads a keyword list (one upper case keyword per line, '#' starts a
+ * comment) and writes a C header holding a perfect hash over it:
+ *
+ *   hash(s) = (length(s) + keywordCharValue[s[0]] + keywordCharValue[s[length-1]])
+ *             % KEYWORD_TABLE_SIZE
+ *
+ * The table size is the number of keywords whenever a collision free set
+ * of character values can be found, so every slot holds a keyword; the
+ * size only grows when no such assignment exists. Keyword k maps to token
+ * type KW_k. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define MAX_IDENT_LEN 15
+#define MAX_KEYWORDS 64
+#define MAX_LINE_LEN 256
+#define SEARCH_ROUNDS 200
+#define SEARCH_STEPS 20000
+
+typedef struct {
+  char string[MAX_IDENT_LEN + 1];
+  int length;
+  unsigned char first, last;
+} Keyword;
+
+Keyword keywords[MAX_KEYWORDS];
+int keywordCount = 0;
+
+int charValue[256];
+int slotUse[2 * MAX_KEYWORDS + 1];
+int tableSize;
+
+unsigned long seed = 20081;
+
+int nextRandom(int bound) {
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return (int) ((seed >> 33) % bound);
+}
+
+int hashKeyword(Keyword *kw) {
+  return (kw->length + charValue[kw->first] + charValue[kw->last]) % tableSize;
+}
+
+int readKeywords(char *fileName) {
+  FILE *f = fopen(fileName, "rt");
+  char line[MAX_LINE_LEN];
+  int lineNo = 0;
+
+  if (f == NULL) {
+    perror(fileName);
+    return 0;
+  }
+
+  while (fgets(line, MAX_LINE_LEN, f) != NULL) {
+    char *p = line, *q;
+    Keyword *kw;
+    int i;
+
+    lineNo ++;
+    while (isspace((unsigned char) *p)) p ++;
+    if ((*p == '\0') || (*p == '#')) continue;
+    for (q = p; isupper((unsigned char) *q); q ++) ;
+    if ((q == p) || (q - p > MAX_IDENT_LEN) || ((*q != '\0') && !isspace((unsigned char) *q))) {
+      fprintf(stderr, "%s:%d: bad keyword\n", fileName, lineNo);
+      fclose(f);
+      return 0;
+    }
+    if (keywordCount == MAX_KEYWORDS) {
+      fprintf(stderr, "%s:%d: too many keywords\n", fileName, lineNo);
+      fclose(f);
+      return 0;
+    }
+
+    kw = &keywords[keywordCount];
+    memset(kw->string, 0, sizeof(kw->string));
+    memcpy(kw->string, p, q - p);
+    kw->length = q - p;
+    kw->first = (unsigned char) p[0];
+    kw->last = (unsigned char) q[-1];
+
+    for (i = 0; i < keywordCount; i++) {
+      if (strcmp(keywords[i].string, kw->string) == 0) {
+        fprintf(stderr, "%s:%d: duplicate keyword %s\n", fileName, lineNo, kw->string);
+        fclose(f);
+        return 0;
+      }
+      if ((keywords[i].length == kw->length) && (keywords[i].first == kw->first) && (keywords[i].last == kw->last)) {
+        fprintf(stderr, "%s:%d: %s and %s share length, first and last letter\n",
+                fileName, lineNo, keywords[i].string, kw->string);
+        fclose(f);
+        return 0;
+      }
+    }
+    keywordCount ++;
+  }
+
+  fclose(f);
+  return 1;
+}
+
+int countCollisions(void) {
+  int i, collisions = 0;
+
+  memset(slotUse, 0, sizeof(slotUse));
+  for (i = 0; i < keywordCount; i++)
+    if (slotUse[hashKeyword(&keywords[i])] ++ > 0)
+      collisions ++;
+  return collisions;
+}
+
+/* Min-conflicts search: starting from random character values, keep
+ * moving one character of a colliding keyword to the value that leaves
+ * the fewest collisions, with an occasional random move to get out of
+ * local minima. */
+int searchCharValues(void) {
+  int round, step, i;
+
+  for (round = 0; round < SEARCH_ROUNDS; round ++) {
+    int collisions;
+
+    for (i = 0; i < 256; i++)
+      charValue[i] = nextRandom(tableSize);
+    collisions = countCollisions();
+
+    for (step = 0; (step < SEARCH_STEPS) && (collisions > 0); step ++) {
+      Keyword *kw;
+      unsigned char c;
+      int v, best, bestCollisions;
+
+      /* pick a keyword that shares its slot */
+      do kw = &keywords[nextRandom(keywordCount)];
+      while (slotUse[hashKeyword(kw)] < 2);
+      c = nextRandom(2) ? kw->first : kw->last;
+
+      if (nextRandom(16) == 0) {
+        charValue[c] = nextRandom(tableSize);
+        collisions = countCollisions();
+        continue;
+      }
+
+      best = charValue[c];
+      bestCollisions = collisions;
+      for (v = 0; v < tableSize; v++) {
+        int n;
+        if (v == best) continue;
+        charValue[c] = v;
+        n = countCollisions();
+        if ((n < bestCollisions) || ((n == bestCollisions) && nextRandom(2))) {
+          best = v;
+          bestCollisions = n;
+        }
+      }
+      charValue[c] = best;
+      collisions = countCollisions();
+    }
+
+    if (collisions == 0) return 1;
+  }
+  return 0;
+}
+
+void writeTable(FILE *f, char *specName) {
+  Keyword *slots[2 * MAX_KEYWORDS];
+  int i, maxLength = 0;
+
+  for (i = 0; i < tableSize; i++)
+    slots[i] = NULL;
+  for (i = 0; i < keywordCount; i++) {
+    slots[hashKeyword(&keywords[i])] = &keywords[i];
+    if (keywords[i].length > maxLength)
+      maxLength = keywords[i].length;
+  }
+
+  fprintf(f, "/* Generated by kwgen from %s. Do not edit. */\n\n", specName);
+  fprintf(f, "#define KEYWORD_TABLE_SIZE %d\n", tableSize);
+  fprintf(f, "#define KEYWORD_MAX_LEN %d\n\n", maxLength);
+
+  fprintf(f, "static const unsigned char keywordCharValue[256] = {");
+  for (i = 0; i < 256; i++) {
+    int used = 0, j;
+    for (j = 0; j < keywordCount; j++)
+      if ((keywords[j].first == i) || (keywords[j].last == i))
+        used = 1;
+    fprintf(f, "%s%d%s", (i % 16 == 0) ? "\n  " : " ", used ? charValue[i] : 0, (i < 255) ? "," : "\n");
+  }
+  fprintf(f, "};\n\n");
+
+  fprintf(f, "static const struct {\n  char string[MAX_IDENT_LEN + 1];\n  TokenType tokenType;\n} keywordTable[KEYWORD_TABLE_SIZE] = {\n");
+  for (i = 0; i < tableSize; i++) {
+    if (slots[i] == NULL)
+      fprintf(f, "  {\"\", TK_NONE}");
+    else fprintf(f, "  {\"%s\", KW_%s}", slots[i]->string, slots[i]->string);
+    fprintf(f, "%s\n", (i < tableSize - 1) ? "," : "");
+  }
+  fprintf(f, "};\n");
+}
+
+int main(int argc, char *argv[]) {
+  FILE *out;
+
+  if (argc != 3) {
+    fprintf(stderr, "usage: kwgen <keyword list> <output header>\n");
+    return 1;
+  }
+  if (!readKeywords(argv[1]))
+    return 1;
+  if (keywordCount == 0) {
+    fprintf(stderr, "%s: no keywords\n", argv[1]);
+    return 1;
+  }
+
+  for (tableSize = keywordCount; tableSize <= 2 * keywordCount; tableSize ++)
+    if (searchCharValues())
+      break;
+  if (tableSize > 2 * keywordCount) {
+    fprintf(stderr, "%s: no perfect hash found\n", argv[1]);
+    return 1;
+  }
+
+  out = fopen(argv[2], "wt");
+  if (out == NULL) {
+    perror(argv[2]);
+    return 1;
+  }
+  writeTable(out, argv[1]);
+  fclose(out);
+  return 0;
+}
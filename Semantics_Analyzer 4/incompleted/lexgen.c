@@ -0,0 +1,297 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+/* Build-time generator for the DFA driven by readToken.
+ *
+ * Reads a token specification (see lexer.def) where each rule names a
+ * token type or an @action and spells it as a sequence of characters or
+ * [letter], [digit] and [space] classes, and writes a C header with:
+ *
+ *   lexClass[byte]         the byte class of every input byte
+ *   lexNext[state][class]  the next state, LEX_STOP, or an action
+ *   lexAccept[state]       the token returned when the DFA stops there
+ *
+ * State LEX_START accepts TK_EOF, since it can only stop at the end of
+ * the input: bytes no rule starts with lead to a state accepting TK_NONE,
+ * which readToken reports as an invalid symbol. Bytes whose columns are
+ * identical share one class, so the table stays a few bytes wide. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define MAX_STATES 128
+#define MAX_ACTIONS 16
+#define MAX_NAME_LEN 32
+#define MAX_LINE_LEN 256
+
+#define NO_STATE 0
+#define START_STATE 1
+
+typedef struct {
+  char accept[MAX_NAME_LEN];      /* token type, or "" */
+  char spelling[MAX_LINE_LEN];    /* what leads here, for the comments */
+  int next[256];                  /* state, -1 - action, or NO_STATE */
+} State;
+
+State states[MAX_STATES];
+int stateCount;                   /* states[0] is the stop state */
+
+char actions[MAX_ACTIONS][MAX_NAME_LEN];
+int actionCount = 0;
+
+int byteClass[256];
+int classByte[256];               /* a representative byte of each class */
+int classCount = 0;
+
+int newState(char *spelling) {
+  State *s = &states[stateCount];
+
+  memset(s, 0, sizeof(State));
+  strcpy(s->spelling, spelling);
+  return stateCount ++;
+}
+
+int findAction(char *name) {
+  int i;
+
+  for (i = 0; i < actionCount; i++)
+    if (strcmp(actions[i], name) == 0)
+      return i;
+  if (actionCount == MAX_ACTIONS)
+    return -1;
+  strcpy(actions[actionCount], name);
+  return actionCount ++;
+}
+
+/* Parses one item of a spelling at *p into the byte set in; returns 0
+ * on a bad item */
+int readItem(char **p, char *in, char *text) {
+  int c;
+
+  memset(in, 0, 256);
+  if (**p != '[') {
+    in[(unsigned char) **p] = 1;
+    text[0] = **p;
+    text[1] = '\0';
+    (*p) ++;
+    return 1;
+  }
+
+  if (strncmp(*p, "[letter]", 8) == 0) {
+    for (c = 0; c < 256; c++)
+      in[c] = ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z'));
+  } else if (strncmp(*p, "[digit]", 7) == 0) {
+    for (c = 0; c < 256; c++)
+      in[c] = (c >= '0') && (c <= '9');
+  } else if (strncmp(*p, "[space]", 7) == 0) {
+    // the CHAR_SPACE bytes of charcode.c
+    for (c = 0; c < 256; c++)
+      in[c] = (c == ' ') || ((c >= '\t') && (c <= '\r'));
+  } else return 0;
+
+  strcpy(text, *p);
+  *strchr(text, ']' ) = '\0';
+  strcat(text, "]");
+  *p = strchr(*p, ']') + 1;
+  return 1;
+}
+
+/* Adds one rule to the DFA; returns 0 when it clashes with another */
+int addRule(char *name, char *spelling, char *fileName, int lineNo) {
+  char in[256], text[MAX_LINE_LEN], prefix[MAX_LINE_LEN] = "";
+  int state = START_STATE, action = -1, c;
+  char *p = spelling;
+
+  if (name[0] == '@') {
+    action = findAction(name + 1);
+    if (action < 0) {
+      fprintf(stderr, "%s:%d: too many actions\n", fileName, lineNo);
+      return 0;
+    }
+  }
+
+  while (*p != '\0') {
+    int target = NO_STATE, last;
+
+    if (!readItem(&p, in, text)) {
+      fprintf(stderr, "%s:%d: bad character class\n", fileName, lineNo);
+      return 0;
+    }
+    strcat(prefix, text);
+    last = (*p == '\0');
+
+    // every byte of the item must lead to the same place
+    for (c = 0; c < 256; c++) {
+      if (!in[c] || (states[state].next[c] == NO_STATE)) continue;
+      if ((target != NO_STATE) && (states[state].next[c] != target)) {
+        fprintf(stderr, "%s:%d: %s overlaps another rule\n", fileName, lineNo, prefix);
+        return 0;
+      }
+      target = states[state].next[c];
+    }
+
+    if ((target < 0) || (last && (action >= 0) && (target != NO_STATE))) {
+      fprintf(stderr, "%s:%d: an action rule is a prefix of %s\n", fileName, lineNo, prefix);
+      return 0;
+    }
+
+    if (target == NO_STATE) {
+      if (last && (action >= 0))
+        target = -1 - action;
+      else if (stateCount == MAX_STATES) {
+        fprintf(stderr, "%s:%d: too many states\n", fileName, lineNo);
+        return 0;
+      } else target = newState(prefix);
+    }
+    for (c = 0; c < 256; c++)
+      if (in[c]) states[state].next[c] = target;
+    state = target;
+  }
+
+  if (action >= 0)
+    return 1;
+  if (states[state].accept[0] != '\0') {
+    fprintf(stderr, "%s:%d: %s is already %s\n", fileName, lineNo, spelling, states[state].accept);
+    return 0;
+  }
+  strcpy(states[state].accept, name);
+  return 1;
+}
+
+int readRules(char *fileName) {
+  FILE *f = fopen(fileName, "rt");
+  char line[MAX_LINE_LEN];
+  int lineNo = 0;
+
+  if (f == NULL) {
+    perror(fileName);
+    return 0;
+  }
+
+  while (fgets(line, MAX_LINE_LEN, f) != NULL) {
+    char *name, *spelling, *end;
+
+    lineNo ++;
+    for (name = line; isspace((unsigned char) *name); name ++) ;
+    if ((*name == '\0') || (*name == '#')) continue;
+
+    for (end = name; (*end != '\0') && !isspace((unsigned char) *end); end ++) ;
+    for (spelling = end; isspace((unsigned char) *spelling); spelling ++) ;
+    *end = '\0';
+    for (end = spelling; (*end != '\0') && !isspace((unsigned char) *end); end ++) ;
+    *end = '\0';
+
+    if ((*spelling == '\0') || (strlen(name) >= MAX_NAME_LEN)) {
+      fprintf(stderr, "%s:%d: bad rule\n", fileName, lineNo);
+      fclose(f);
+      return 0;
+    }
+    if (!addRule(name, spelling, fileName, lineNo)) {
+      fclose(f);
+      return 0;
+    }
+  }
+
+  fclose(f);
+  return 1;
+}
+
+/* Sends the bytes no rule starts with to a state of their own, and
+ * splits the bytes into classes of identical columns */
+void finishTable(void) {
+  int invalid = newState("invalid symbol");
+  int b, c, s;
+
+  strcpy(states[invalid].accept, "TK_NONE");
+  strcpy(states[START_STATE].accept, "TK_EOF");
+  for (b = 0; b < 256; b++)
+    if (states[START_STATE].next[b] == NO_STATE)
+      states[START_STATE].next[b] = invalid;
+  for (s = START_STATE; s < stateCount; s++)
+    if (states[s].accept[0] == '\0')
+      strcpy(states[s].accept, "TK_NONE");
+
+  for (b = 0; b < 256; b++) {
+    for (c = 0; c < classCount; c++) {
+      for (s = START_STATE; s < stateCount; s++)
+        if (states[s].next[b] != states[s].next[classByte[c]])
+          break;
+      if (s == stateCount) break;
+    }
+    if (c == classCount)
+      classByte[classCount ++] = b;
+    byteClass[b] = c;
+  }
+}
+
+void writeTable(FILE *f, char *specName) {
+  int b, c, s, a;
+
+  fprintf(f, "/* Generated by lexgen from %s. Do not edit. */\n\n", specName);
+  fprintf(f, "#define LEX_STATE_COUNT %d\n", stateCount);
+  fprintf(f, "#define LEX_CLASS_COUNT %d\n\n", classCount);
+  fprintf(f, "#define LEX_STOP %d\n", NO_STATE);
+  fprintf(f, "#define LEX_START %d\n", START_STATE);
+  fprintf(f, "#define LEX_FIRST_ACTION %d\n\n", stateCount);
+
+  fprintf(f, "enum {\n");
+  for (a = 0; a < actionCount; a++)
+    fprintf(f, "  LEX_%s = %d%s\n", actions[a], stateCount + a, (a < actionCount - 1) ? "," : "");
+  fprintf(f, "};\n\n");
+
+  fprintf(f, "static const unsigned char lexClass[256] = {");
+  for (b = 0; b < 256; b++)
+    fprintf(f, "%s%d%s", (b % 16 == 0) ? "\n  " : " ", byteClass[b], (b < 255) ? "," : "\n");
+  fprintf(f, "};\n\n");
+
+  fprintf(f, "static const unsigned char lexNext[LEX_STATE_COUNT][LEX_CLASS_COUNT] = {\n");
+  for (s = 0; s < stateCount; s++) {
+    fprintf(f, "  {");
+    for (c = 0; c < classCount; c++) {
+      int next = (s == NO_STATE) ? NO_STATE : states[s].next[classByte[c]];
+      if (next < 0) next = stateCount - 1 - next;
+      fprintf(f, "%s%d", (c > 0) ? ", " : "", next);
+    }
+    fprintf(f, "}%s   /* %s */\n", (s < stateCount - 1) ? "," : "",
+            (s == NO_STATE) ? "stop" : ((s == START_STATE) ? "start" : states[s].spelling));
+  }
+  fprintf(f, "};\n\n");
+
+  fprintf(f, "static const TokenType lexAccept[LEX_STATE_COUNT] = {\n");
+  for (s = 0; s < stateCount; s++)
+    fprintf(f, "  %s%s\n", (s == NO_STATE) ? "TK_NONE" : states[s].accept, (s < stateCount - 1) ? "," : "");
+  fprintf(f, "};\n");
+}
+
+int main(int argc, char *argv[]) {
+  FILE *out;
+
+  if (argc != 3) {
+    fprintf(stderr, "usage: lexgen <token specification> <output header>\n");
+    return 1;
+  }
+
+  newState("");                   /* the stop state */
+  newState("");                   /* the start state */
+  if (!readRules(argv[1]))
+    return 1;
+  finishTable();
+  if (stateCount + actionCount > 256) {
+    fprintf(stderr, "%s: too many states and actions\n", argv[1]);
+    return 1;
+  }
+
+  out = fopen(argv[2], "wt");
+  if (out == NULL) {
+    perror(argv[2]);
+    return 1;
+  }
+  writeTable(out, argv[1]);
+  fclose(out);
+  return 0;
+}
@@ -0,0 +1,459 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "reader.h"
+#include "loader.h"
+
+#define LOADER_WINDOW 64       /* files in flight at once */
+#define LOADER_THREADS 16      /* pread threads of the fallback */
+
+/* io_uring operations tagged in user_data, below the slot number */
+#define OP_OPEN 0
+#define OP_STATX 1
+#define OP_READ 2
+#define OP_BITS 2
+
+/******************* io_uring ******************************/
+
+typedef struct {
+  int fd;
+  unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+  unsigned sqEntries;
+  struct io_uring_sqe *sqes;
+  unsigned *cqHead, *cqTail, *cqMask;
+  struct io_uring_cqe *cqes;
+  void *sqRing, *cqRing;
+  size_t sqRingSize, cqRingSize, sqesSize;
+  unsigned queued;               /* sqes written but not yet submitted */
+  unsigned inflight;             /* sqes submitted whose cqe is not yet reaped */
+} Ring;
+
+typedef struct {
+  SourceFile source;
+  int fd;
+  struct statx stx;
+  int pending;                   /* operations still in the kernel */
+  int opened, sized, failed, tooLarge;
+  size_t done;                   /* bytes read so far */
+} LoadSlot;
+
+int setupRing(Ring *ring, unsigned entries) {
+  struct io_uring_params params;
+  struct io_uring_probe *probe;
+  size_t probeSize = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+  int supported;
+
+  memset(&params, 0, sizeof(params));
+  ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+  if (ring->fd < 0)
+    return 0;
+
+  // the open, statx and read operations all need to be available
+  probe = (struct io_uring_probe*) calloc(1, probeSize);
+  supported = (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, 256) == 0)
+    && (probe->last_op >= IORING_OP_READ)
+    && (probe->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED)
+    && (probe->ops[IORING_OP_STATX].flags & IO_URING_OP_SUPPORTED)
+    && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+  free(probe);
+  if (!supported) {
+    close(ring->fd);
+    return 0;
+  }
+
+  ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (ring->cqRingSize > ring->sqRingSize) ring->sqRingSize = ring->cqRingSize;
+    ring->cqRingSize = ring->sqRingSize;
+  }
+  ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQ_RING);
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+    ring->cqRing = ring->sqRing;
+  else ring->cqRing = mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ring->fd, IORING_OFF_CQ_RING);
+  ring->sqes = (struct io_uring_sqe*) mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE,
+                                           MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if ((ring->sqRing == MAP_FAILED) || (ring->cqRing == MAP_FAILED) || (ring->sqes == MAP_FAILED)) {
+    close(ring->fd);
+    return 0;
+  }
+
+  ring->sqHead = (unsigned*) ((char*) ring->sqRing + params.sq_off.head);
+  ring->sqTail = (unsigned*) ((char*) ring->sqRing + params.sq_off.tail);
+  ring->sqMask = (unsigned*) ((char*) ring->sqRing + params.sq_off.ring_mask);
+  ring->sqArray = (unsigned*) ((char*) ring->sqRing + params.sq_off.array);
+  ring->sqEntries = params.sq_entries;
+  ring->cqHead = (unsigned*) ((char*) ring->cqRing + params.cq_off.head);
+  ring->cqTail = (unsigned*) ((char*) ring->cqRing + params.cq_off.tail);
+  ring->cqMask = (unsigned*) ((char*) ring->cqRing + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe*) ((char*) ring->cqRing + params.cq_off.cqes);
+  ring->queued = 0;
+  ring->inflight = 0;
+  return 1;
+}
+
+void closeRing(Ring *ring) {
+  munmap(ring->sqes, ring->sqesSize);
+  if (ring->cqRing != ring->sqRing)
+    munmap(ring->cqRing, ring->cqRingSize);
+  munmap(ring->sqRing, ring->sqRingSize);
+  close(ring->fd);
+}
+
+/* The window keeps at most two operations per slot in flight, so the
+ * submission queue never fills up. */
+struct io_uring_sqe *nextSqe(Ring *ring, int slot, int op) {
+  unsigned tail = *ring->sqTail;
+  unsigned index = tail & *ring->sqMask;
+  struct io_uring_sqe *sqe = &ring->sqes[index];
+
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  sqe->user_data = ((unsigned long long) slot << OP_BITS) | op;
+  ring->sqArray[index] = index;
+  __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+  ring->queued ++;
+  return sqe;
+}
+
+void submitOpen(Ring *ring, LoadSlot *slots, int slot) {
+  struct io_uring_sqe *sqe;
+
+  sqe = nextSqe(ring, slot, OP_OPEN);
+  sqe->opcode = IORING_OP_OPENAT;
+  sqe->fd = AT_FDCWD;
+  sqe->addr = (unsigned long) slots[slot].source.fileName;
+  sqe->open_flags = O_RDONLY;
+
+  sqe = nextSqe(ring, slot, OP_STATX);
+  sqe->opcode = IORING_OP_STATX;
+  sqe->fd = AT_FDCWD;
+  sqe->addr = (unsigned long) slots[slot].source.fileName;
+  sqe->len = STATX_SIZE | STATX_TYPE;
+  sqe->off = (unsigned long) &slots[slot].stx;
+
+  slots[slot].pending = 2;
+}
+
+void submitRead(Ring *ring, LoadSlot *slots, int slot) {
+  LoadSlot *s = &slots[slot];
+  struct io_uring_sqe *sqe = nextSqe(ring, slot, OP_READ);
+
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = s->fd;
+  sqe->addr = (unsigned long) (s->source.data + s->done);
+  sqe->len = s->source.size - s->done;
+  sqe->off = s->done;
+  s->pending ++;
+}
+
+void finishSlot(LoadSlot *s, SourceHandler handler, void *arg) {
+  if (s->opened)
+    close(s->fd);
+  s->source.status = s->tooLarge ? IO_TOO_LARGE : s->failed ? IO_ERROR : IO_SUCCESS;
+  if (s->failed)
+    s->source.size = 0;
+  handler(&s->source, arg);
+  free(s->source.data);
+}
+
+/* One completion; returns 1 when the slot is done with */
+int completeSlot(Ring *ring, LoadSlot *slots, int slot, int op, int res) {
+  LoadSlot *s = &slots[slot];
+
+  s->pending --;
+  switch (op) {
+  case OP_OPEN:
+    if (res < 0) s->failed = 1;
+    else {
+      s->fd = res;
+      s->opened = 1;
+    }
+    break;
+  case OP_STATX:
+    if ((res < 0) || !S_ISREG(s->stx.stx_mode)) s->failed = 1;
+    else if (s->stx.stx_size > MAX_SOURCE_SIZE) s->failed = s->tooLarge = 1;
+    else {
+      s->source.size = s->stx.stx_size;
+      s->sized = 1;
+    }
+    break;
+  case OP_READ:
+    if (res < 0) s->failed = 1;
+    else if (res == 0) s->source.size = s->done;    // the file shrank
+    else s->done += res;
+    break;
+  }
+
+  if (s->pending > 0)
+    return 0;
+  if (s->failed)
+    return 1;
+  if (s->opened && s->sized && (s->source.data == NULL)) {
+    s->source.data = (char*) malloc(s->source.size + 1);
+    if (s->source.data == NULL) {
+      s->failed = 1;
+      return 1;
+    }
+  }
+  if (s->done < s->source.size) {
+    submitRead(ring, slots, slot);
+    return 0;
+  }
+  return 1;
+}
+
+void loadWithThreads(char **fileNames, int *indexes, int count, SourceHandler handler, void *arg);
+
+/* Hands the files still in flight, and those not yet started, over to
+ * the threads after the ring failed. The kernel may still write to the
+ * slots of the files in flight, so their memory and descriptors are
+ * left to it rather than freed. */
+void abandonRing(LoadSlot *slots, int *freeSlots, int freeCount, char **fileNames, int next, int count,
+                 SourceHandler handler, void *arg) {
+  char **names = (char**) malloc((LOADER_WINDOW + count - next) * sizeof(char*));
+  int *indexes = (int*) malloc((LOADER_WINDOW + count - next) * sizeof(int));
+  int isFree[LOADER_WINDOW];
+  int left = 0, i;
+
+  memset(isFree, 0, sizeof(isFree));
+  for (i = 0; i < freeCount; i ++)
+    isFree[freeSlots[i]] = 1;
+  for (i = 0; i < LOADER_WINDOW; i ++)
+    if (!isFree[i]) {
+      names[left] = slots[i].source.fileName;
+      indexes[left ++] = slots[i].source.index;
+    }
+  for (i = next; i < count; i ++) {
+    names[left] = fileNames[i];
+    indexes[left ++] = i;
+  }
+
+  loadWithThreads(names, indexes, left, handler, arg);
+  free(names);
+  free(indexes);
+}
+
+void loadWithRing(Ring *ring, char **fileNames, int count, SourceHandler handler, void *arg) {
+  LoadSlot *slots = (LoadSlot*) malloc(LOADER_WINDOW * sizeof(LoadSlot));
+  int freeSlots[LOADER_WINDOW], freeCount = 0;
+  int next = 0, finished = 0, i;
+
+  for (i = LOADER_WINDOW - 1; i >= 0; i --)
+    freeSlots[freeCount++] = i;
+
+  while (finished < count) {
+    unsigned head, tail;
+    long ret;
+
+    while ((freeCount > 0) && (next < count)) {
+      int slot = freeSlots[--freeCount];
+      memset(&slots[slot], 0, sizeof(LoadSlot));
+      slots[slot].source.index = next;
+      slots[slot].source.fileName = fileNames[next];
+      next ++;
+      submitOpen(ring, slots, slot);
+    }
+
+    // the kernel may take fewer sqes than it is given; the rest stay in
+    // the submission queue and are handed over again until it drains.
+    // It is only asked to wait when an operation taken earlier is sure
+    // to complete, never on sqes it may not take
+    do {
+      ret = syscall(__NR_io_uring_enter, ring->fd, ring->queued, (ring->inflight > 0) ? 1 : 0,
+                    IORING_ENTER_GETEVENTS, NULL, 0);
+      if (ret >= 0) {
+        ring->queued -= ret;
+        ring->inflight += ret;
+      } else if ((errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY)) {
+        abandonRing(slots, freeSlots, freeCount, fileNames, next, count, handler, arg);
+        return;
+      }
+    } while ((ring->queued > 0) && (ret > 0));
+
+    head = *ring->cqHead;
+    tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+      struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+      int slot = (int) (cqe->user_data >> OP_BITS);
+      int op = (int) (cqe->user_data & ((1 << OP_BITS) - 1));
+
+      head ++;
+      ring->inflight --;
+      if (completeSlot(ring, slots, slot, op, cqe->res)) {
+        finishSlot(&slots[slot], handler, arg);
+        freeSlots[freeCount++] = slot;
+        finished ++;
+      }
+    }
+    __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+  }
+  free(slots);
+}
+
+/******************* pread fallback ******************************/
+
+typedef struct LoadedNode_ {
+  SourceFile source;
+  struct LoadedNode_ *next;
+} LoadedNode;
+
+typedef struct {
+  char **fileNames;
+  int *indexes;                  /* of the files in the list given to loadSources, or NULL */
+  int count;
+  int next;                      /* next file to hand to a thread */
+  LoadedNode *head, *tail;       /* loaded files waiting for the handler */
+  int waiting;
+  pthread_mutex_t lock;
+  pthread_cond_t loaded;         /* a file was queued */
+  pthread_cond_t drained;        /* the handler took a file */
+} LoadQueue;
+
+void readSource(SourceFile *source) {
+  struct stat st;
+  ssize_t n;
+  int fd;
+
+  source->data = NULL;
+  source->size = 0;
+  source->status = IO_ERROR;
+
+  fd = open(source->fileName, O_RDONLY);
+  if (fd < 0)
+    return;
+  if ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode)) {
+    if ((unsigned long long) st.st_size > MAX_SOURCE_SIZE) {
+      source->status = IO_TOO_LARGE;
+      close(fd);
+      return;
+    }
+    source->data = (char*) malloc(st.st_size + 1);
+    if (source->data != NULL) {
+      source->status = IO_SUCCESS;
+      while (source->size < (size_t) st.st_size) {
+        n = pread(fd, source->data + source->size, st.st_size - source->size, source->size);
+        if (n < 0) source->status = IO_ERROR;
+        if (n <= 0) break;
+        source->size += n;
+      }
+    }
+  }
+  close(fd);
+}
+
+void *loadWorker(void *arg) {
+  LoadQueue *queue = (LoadQueue*) arg;
+
+  pthread_mutex_lock(&queue->lock);
+  while (queue->next < queue->count) {
+    LoadedNode *node = (LoadedNode*) malloc(sizeof(LoadedNode));
+    node->source.index = (queue->indexes != NULL) ? queue->indexes[queue->next] : queue->next;
+    node->source.fileName = queue->fileNames[queue->next];
+    node->next = NULL;
+    queue->next ++;
+    pthread_mutex_unlock(&queue->lock);
+
+    readSource(&node->source);
+
+    pthread_mutex_lock(&queue->lock);
+    // keep memory bounded when the handler falls behind
+    while (queue->waiting >= LOADER_WINDOW)
+      pthread_cond_wait(&queue->drained, &queue->lock);
+    if (queue->tail == NULL) queue->head = node;
+    else queue->tail->next = node;
+    queue->tail = node;
+    queue->waiting ++;
+    pthread_cond_signal(&queue->loaded);
+  }
+  pthread_mutex_unlock(&queue->lock);
+  return NULL;
+}
+
+void loadWithThreads(char **fileNames, int *indexes, int count, SourceHandler handler, void *arg) {
+  pthread_t threads[LOADER_THREADS];
+  int started = 0, handled = 0, i;
+  LoadQueue queue;
+  SourceFile source;
+
+  memset(&queue, 0, sizeof(LoadQueue));
+  queue.fileNames = fileNames;
+  queue.indexes = indexes;
+  queue.count = count;
+  pthread_mutex_init(&queue.lock, NULL);
+  pthread_cond_init(&queue.loaded, NULL);
+  pthread_cond_init(&queue.drained, NULL);
+
+  for (i = 0; (i < LOADER_THREADS) && (i < count); i ++)
+    if (pthread_create(&threads[started], NULL, loadWorker, &queue) == 0)
+      started ++;
+  // no threads at all: each file is loaded and handled here in turn, as
+  // going through the queue would block once the window fills up
+  if (started == 0) {
+    for (i = 0; i < count; i ++) {
+      source.index = (indexes != NULL) ? indexes[i] : i;
+      source.fileName = fileNames[i];
+      readSource(&source);
+      handler(&source, arg);
+      free(source.data);
+    }
+    handled = count;
+  }
+
+  while (handled < count) {
+    LoadedNode *node;
+
+    pthread_mutex_lock(&queue.lock);
+    while (queue.head == NULL)
+      pthread_cond_wait(&queue.loaded, &queue.lock);
+    node = queue.head;
+    queue.head = node->next;
+    if (queue.head == NULL) queue.tail = NULL;
+    queue.waiting --;
+    pthread_cond_signal(&queue.drained);
+    pthread_mutex_unlock(&queue.lock);
+
+    handler(&node->source, arg);
+    free(node->source.data);
+    free(node);
+    handled ++;
+  }
+
+  for (i = 0; i < started; i ++)
+    pthread_join(threads[i], NULL);
+  pthread_mutex_destroy(&queue.lock);
+  pthread_cond_destroy(&queue.loaded);
+  pthread_cond_destroy(&queue.drained);
+}
+
+/******************************************************************/
+
+void loadSources(char **fileNames, int count, SourceHandler handler, void *arg) {
+  Ring ring;
+
+  if (count <= 0)
+    return;
+  if ((getenv("KPLC_NO_IO_URING") == NULL) && setupRing(&ring, 2 * LOADER_WINDOW)) {
+    loadWithRing(&ring, fileNames, count, handler, arg);
+    closeRing(&ring);
+  } else loadWithThreads(fileNames, NULL, count, handler, arg);
+}
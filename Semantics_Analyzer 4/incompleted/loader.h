@@ -0,0 +1,29 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __LOADER_H__
+#define __LOADER_H__
+
+#include <stddef.h>
+
+/* A source file read into memory by loadSources */
+typedef struct {
+  int index;            /* position of the file in the list given to loadSources */
+  char *fileName;
+  char *data;           /* the file contents, valid until the handler returns */
+  size_t size;
+  int status;           /* IO_SUCCESS, IO_ERROR if the file could not be read,
+                           or IO_TOO_LARGE */
+} SourceFile;
+
+typedef void (*SourceHandler)(SourceFile *source, void *arg);
+
+/* Reads many files at once and calls handler for each of them, in the
+ * order they finish loading, on the calling thread. Uses io_uring when
+ * the kernel offers it and a pool of pread threads otherwise. */
+void loadSources(char **fileNames, int count, SourceHandler handler, void *arg);
+
+#endif
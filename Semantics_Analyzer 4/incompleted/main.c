@@ -6,21 +6,116 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 
 #include "reader.h"
 #include "parser.h"
+#include "loader.h"
+#include "batch.h"
 
 /******************************************************************/
 
+/* What is printed instead of the result of an input not compiled */
+void printInputError(int status) {
+  if (status == IO_TOO_LARGE)
+    printf("Input file too large!\n");
+  else printf("Can\'t read input file!\n");
+}
+
+/* Compiles each file of a batch as soon as the loader has it in memory */
+void compileSource(SourceFile *source, void *arg) {
+  CompileResult *result;
+
+  printf("==> %s <==\n", source->fileName);
+  if (source->status != IO_SUCCESS) {
+    printInputError(source->status);
+    return;
+  }
+  result = compileBuffer(source->data, source->size);
+  if (result == NULL) {
+    printInputError(IO_TOO_LARGE);
+    return;
+  }
+  printCompileResult(result);
+  freeCompileResult(result);
+}
+
+/* Prints the results of a batch, which come in the order of the files */
+void printBatchResult(int index, char *fileName, int status, CompileResult *result, void *arg) {
+  printf("==> %s <==\n", fileName);
+  if (status != IO_SUCCESS)
+    printInputError(status);
+  else printCompileResult(result);
+}
+
 int main(int argc, char *argv[]) {
-//  if (argc <= 1) {
-//    printf("parser: no input file.\n");
-//    return -1;
-//  }
+  char *fileName = "tests/error10.kpl";
+  char **fileNames;
+  int count, status, jobs = -1;
+  char *manifest = NULL;
+  BatchStats stats;
+
+  // --cache DIR reuses the tokens of inputs seen before,
+  // --max-errors N reports up to N errors per input instead of one, and
+  // --ast prints the tree of each program parsed to the end,
+  // --jobs N compiles the files as a batch on N threads, 0 for one per
+  // processor, and --manifest FILE adds the files listed in FILE to it
+  while (argc > 2) {
+    if (strcmp(argv[1], "--ast") == 0) {
+      setBuildAst(1);
+      argv++;
+      argc--;
+      continue;
+    }
+    if (strcmp(argv[1], "--cache") == 0) {
+      mkdir(argv[2], 0777);
+      setTokenCache(argv[2]);
+    } else if (strcmp(argv[1], "--max-errors") == 0)
+      setMaxErrors(atoi(argv[2]));
+    else if (strcmp(argv[1], "--jobs") == 0)
+      jobs = atoi(argv[2]);
+    else if (strcmp(argv[1], "--manifest") == 0)
+      manifest = argv[2];
+    else break;
+    argv += 2;
+    argc -= 2;
+  }
+
+  if ((jobs >= 0) || (manifest != NULL)) {
+    count = argc - 1;
+    fileNames = argv + 1;
+    if (manifest != NULL) {
+      count = readManifest(manifest, &fileNames);
+      if (count < 0) {
+        printf("Can\'t read manifest file!\n");
+        return -1;
+      }
+      fileNames = (char**) realloc(fileNames, (count + argc) * sizeof(char*));
+      memcpy(fileNames + count, argv + 1, (argc - 1) * sizeof(char*));
+      count += argc - 1;
+    }
+
+    compileBatch(fileNames, count, (jobs < 0) ? 0 : jobs, printBatchResult, NULL, &stats);
+    fflush(stdout);
+    fprintf(stderr, "%d files on %d threads in %.3f s: %.1f files/s, p99 latency %.3f ms\n",
+            stats.files, stats.jobs, stats.seconds, stats.filesPerSecond, stats.p99Latency * 1000);
+    return 0;
+  }
+
+  // several files are loaded together and compiled as they arrive
+  if (argc > 2) {
+    loadSources(argv + 1, argc - 1, compileSource, NULL);
+    return 0;
+  }
 
+  // "-" reads the program from the standard input
+  if (argc > 1)
+    fileName = argv[1];
 
-    if (compile("tests/error10.kpl") == IO_ERROR) {
-    printf("Can\'t read input file!\n");
+  status = compile(fileName);
+  if (status != IO_SUCCESS) {
+    printInputError(status);
     return -1;
   }
     
@@ -8,512 +8,811 @@
 
 #include "reader.h"
 #include "scanner.h"
+#include "tokstream.h"
+#include "tokcache.h"
 #include "parser.h"
 #include "semantics.h"
+#include "ast.h"
 #include "error.h"
 #include "debug.h"
 
-Token *currentToken;
-Token *lookAhead;
+/* With pre-tokenization on, a whole-buffer input is lexed up front into
+ * a token stream and the ring is filled from it instead of the scanner */
+int pretokenize = 1;
 
-extern Type *intType;
-extern Type *charType;
-extern SymTab *symtab;
+/* Directory of the token cache, or NULL when the cache is off */
+const char *tokenCache = NULL;
 
-void scan(void) {
-    Token *tmp = currentToken;
-    currentToken = lookAhead;
-    lookAhead = getValidToken();
-    free(tmp);
+/* How many errors are reported per input. Past the first, the parser
+ * recovers from each error at the end of the statement or declaration
+ * it was found in, and goes on. */
+int maxErrors = 1;
+
+/* Whether the tree of the program is built */
+int buildAst = 0;
+
+/* Threads that lex one input up front, 0 for one per processor. Per
+ * thread, so that a thread that is one of many compiling at once can
+ * lex alone. */
+__thread int lexThreads = 0;
+
+void setPretokenize(int on) {
+    pretokenize = on;
+}
+
+void setTokenCache(const char *directory) {
+    tokenCache = directory;
 }
 
-void eat(TokenType tokenType) {
-    if (lookAhead->tokenType == tokenType) {
-        scan();
-    } else missingToken(tokenType, lookAhead->lineNo, lookAhead->colNo);
+void setMaxErrors(int count) {
+    maxErrors = (count < 1) ? 1 : count;
 }
 
-void compileProgram(void) {
+void setBuildAst(int on) {
+    buildAst = on;
+}
+
+int setLexThreads(int threads) {
+    int previous = lexThreads;
+    lexThreads = threads;
+    return previous;
+}
+
+void initCompileContext(CompileContext *context, Scanner *scanner) {
+    context->scanner = scanner;
+    context->tokenStream = NULL;
+    context->atoms = NULL;
+    context->symtab = NULL;
+    context->ast = NULL;
+    resetTokenRing(context);
+}
+
+void resetTokenRing(CompileContext *context) {
+    context->ringHead = 0;
+    context->ringFilled = 0;
+    context->currentToken = NULL;
+    context->lookAhead = NULL;
+    freeTokenStream(context->tokenStream);
+    context->tokenStream = NULL;
+    context->streamNext = 0;
+}
+
+/* Lexes the input up front if pre-tokenization is on and the input is
+ * held whole, or takes its tokens from the cache; streamed input is
+ * always scanned as the parser goes */
+void startTokens(CompileContext *context) {
+    if (pretokenize && (context->scanner->input.kind != INPUT_STREAM)) {
+        if (tokenCache != NULL)
+            context->tokenStream = loadTokenCache(tokenCache, context->scanner);
+        if (context->tokenStream == NULL) {
+            context->tokenStream = tokenizeInputParallel(context->scanner, lexThreads);
+            if (tokenCache != NULL)
+                storeTokenCache(tokenCache, context->tokenStream);
+        }
+    }
+    context->lookAhead = peekToken(context, 0);
+}
+
+Token *peekToken(CompileContext *context, int k) {
+    Token *token;
+
+    while (context->ringFilled <= k) {
+        token = &context->tokenRing[(context->ringHead + context->ringFilled) & (TOKEN_RING_SIZE - 1)];
+        if (context->tokenStream != NULL)
+            readStreamToken(context->tokenStream, context->streamNext ++, token);
+        else readValidToken(context->scanner, token);
+        context->ringFilled ++;
+    }
+    return &context->tokenRing[(context->ringHead + k) & (TOKEN_RING_SIZE - 1)];
+}
+
+void scan(CompileContext *context) {
+    context->currentToken = context->lookAhead;
+    context->ringHead = (context->ringHead + 1) & (TOKEN_RING_SIZE - 1);
+    context->ringFilled --;
+    context->lookAhead = peekToken(context, 0);
+}
+
+void eat(CompileContext *context, TokenType tokenType) {
+    if (context->lookAhead->tokenType == tokenType) {
+        scan(context);
+    } else missingToken(tokenType, context->lookAhead->offset);
+}
+
+/* Runs compile, and when more than one error may be reported, recovers
+ * from an error in it: the error is logged, the scope it was found in
+ * left, and the tokens skip passes over are dropped, so that compiling
+ * can go on from there. When the log is full the error is raised again. */
+void compileRecovering(CompileContext *context, void (*compile)(CompileContext*), void (*skip)(CompileContext*)) {
+    ErrorTrap trap;
+    Scope *scope = context->symtab->currentScope;
+    AstMark mark = markAst(context->ast);
+
+    if (maxErrors == 1) {
+        compile(context);
+        return;
+    }
+
+    armErrorTrap(&trap);
+    if (setjmp(trap.env) == 0) {
+        compile(context);
+        disarmErrorTrap();
+    } else {
+        disarmErrorTrap();
+        if (!logDiagnostic(&trap.diagnostic))
+            reportDiagnostic(&trap.diagnostic);
+        context->symtab->currentScope = scope;
+        resetAst(context->ast, mark);
+        addLeaf(context->ast, AST_ERROR, trap.diagnostic.offset, 0);
+        skip(context);
+    }
+}
+
+/* Passes over the rest of a statement, up to the ';' or END after it;
+ * the BEGIN and END of the statements inside it are matched */
+void skipStatement(CompileContext *context) {
+    int depth = 0;
+
+    for (;;) {
+        switch (context->lookAhead->tokenType) {
+            case KW_BEGIN:
+                depth ++;
+                break;
+            case KW_END:
+                if (depth == 0) return;
+                depth --;
+                break;
+            case SB_SEMICOLON:
+                if (depth == 0) return;
+                break;
+            case SB_PERIOD:
+            case TK_EOF:
+                return;
+            default:
+                break;
+        }
+        scan(context);
+    }
+}
+
+/* Passes over the rest of a constant, type or variable declaration, its
+ * ';' included, or up to what starts another part of the block */
+void skipDeclaration(CompileContext *context) {
+    for (;;) {
+        switch (context->lookAhead->tokenType) {
+            case SB_SEMICOLON:
+                scan(context);
+                return;
+            case KW_CONST:
+            case KW_TYPE:
+            case KW_VAR:
+            case KW_FUNCTION:
+            case KW_PROCEDURE:
+            case KW_BEGIN:
+            case SB_PERIOD:
+            case TK_EOF:
+                return;
+            default:
+                scan(context);
+        }
+    }
+}
+
+/* Passes over the rest of a function or procedure heading, its ';'
+ * included; the ';' and VAR between parameters are not its end */
+void skipHeading(CompileContext *context) {
+    int depth = 0;
+
+    for (;;) {
+        switch (context->lookAhead->tokenType) {
+            case SB_LPAR:
+                depth ++;
+                break;
+            case SB_RPAR:
+                if (depth > 0) depth --;
+                break;
+            case SB_SEMICOLON:
+                if (depth == 0) {
+                    scan(context);
+                    return;
+                }
+                break;
+            case KW_VAR:
+                if (depth == 0) return;
+                break;
+            case KW_CONST:
+            case KW_TYPE:
+            case KW_FUNCTION:
+            case KW_PROCEDURE:
+            case KW_BEGIN:
+            case SB_PERIOD:
+            case TK_EOF:
+                return;
+            default:
+                break;
+        }
+        scan(context);
+    }
+}
+
+/* Passes over a function or procedure declaration up to the next one,
+ * or the body of the block they are declared in */
+void skipSubDecl(CompileContext *context) {
+    do {
+        scan(context);
+    } while ((context->lookAhead->tokenType != KW_FUNCTION) && (context->lookAhead->tokenType != KW_PROCEDURE) &&
+             (context->lookAhead->tokenType != KW_BEGIN) && (context->lookAhead->tokenType != SB_PERIOD) &&
+             (context->lookAhead->tokenType != TK_EOF));
+}
+
+void compileProgram(CompileContext *context) {
     Object *program;
 
-    eat(KW_PROGRAM);
-    eat(TK_IDENT);
+    eat(context, KW_PROGRAM);
+    eat(context, TK_IDENT);
+
+    program = createProgramObject(context->symtab, context->currentToken->atom);
+    enterBlock(context->symtab, program->progAttrs->scope);
+    openNode(context->ast, AST_PROGRAM, 0, context->currentToken->offset, context->currentToken->atom);
+
+    eat(context, SB_SEMICOLON);
 
-    program = createProgramObject(currentToken->string);
-    enterBlock(program->progAttrs->scope);
+    compileBlock(context);
+    eat(context, SB_PERIOD);
 
-    eat(SB_SEMICOLON);
+    closeNode(context->ast);
+    exitBlock(context->symtab);
+}
+
+void compileBlock(CompileContext *context) {
+    openNode(context->ast, AST_BLOCK, 0, context->lookAhead->offset, 0);
+    if (context->lookAhead->tokenType == KW_CONST) {
+        eat(context, KW_CONST);
 
-    compileBlock();
-    eat(SB_PERIOD);
+        do {
+            compileRecovering(context, compileConstDecl, skipDeclaration);
+        } while (context->lookAhead->tokenType == TK_IDENT);
 
-    exitBlock();
+        compileBlock2(context);
+    } else compileBlock2(context);
+    closeNode(context->ast);
 }
 
-void compileBlock(void) {
+void compileConstDecl(CompileContext *context) {
     Object *constObj;
     ConstantValue *constValue;
 
-    if (lookAhead->tokenType == KW_CONST) {
-        eat(KW_CONST);
+    eat(context, TK_IDENT);
 
-        do {
-            eat(TK_IDENT);
+    checkFreshIdent(context, context->currentToken->atom);
+    constObj = createConstantObject(context->currentToken->atom);
+    openNode(context->ast, AST_CONST_DECL, 0, context->currentToken->offset, context->currentToken->atom);
 
-            checkFreshIdent(currentToken->string);
-            constObj = createConstantObject(currentToken->string);
+    eat(context, SB_EQ);
+    constValue = compileConstant(context);
 
-            eat(SB_EQ);
-            constValue = compileConstant();
+    constObj->constAttrs->value = constValue;
+    declareObject(context->symtab, constObj);
+    closeNode(context->ast);
 
-            constObj->constAttrs->value = constValue;
-            declareObject(constObj);
+    eat(context, SB_SEMICOLON);
+}
 
-            eat(SB_SEMICOLON);
-        } while (lookAhead->tokenType == TK_IDENT);
+void compileBlock2(CompileContext *context) {
+    if (context->lookAhead->tokenType == KW_TYPE) {
+        eat(context, KW_TYPE);
 
-        compileBlock2();
-    } else compileBlock2();
+        do {
+            compileRecovering(context, compileTypeDecl, skipDeclaration);
+        } while (context->lookAhead->tokenType == TK_IDENT);
+
+        compileBlock3(context);
+    } else compileBlock3(context);
 }
 
-void compileBlock2(void) {
+void compileTypeDecl(CompileContext *context) {
     Object *typeObj;
     Type *actualType;
 
-    if (lookAhead->tokenType == KW_TYPE) {
-        eat(KW_TYPE);
+    eat(context, TK_IDENT);
 
-        do {
-            eat(TK_IDENT);
+    checkFreshIdent(context, context->currentToken->atom);
+    typeObj = createTypeObject(context->currentToken->atom);
+    openNode(context->ast, AST_TYPE_DECL, 0, context->currentToken->offset, context->currentToken->atom);
+
+    eat(context, SB_EQ);
+    actualType = compileType(context);
 
-            checkFreshIdent(currentToken->string);
-            typeObj = createTypeObject(currentToken->string);
+    typeObj->typeAttrs->actualType = actualType;
+    declareObject(context->symtab, typeObj);
+    closeNode(context->ast);
 
-            eat(SB_EQ);
-            actualType = compileType();
+    eat(context, SB_SEMICOLON);
+}
 
-            typeObj->typeAttrs->actualType = actualType;
-            declareObject(typeObj);
+void compileBlock3(CompileContext *context) {
+    if (context->lookAhead->tokenType == KW_VAR) {
+        eat(context, KW_VAR);
 
-            eat(SB_SEMICOLON);
-        } while (lookAhead->tokenType == TK_IDENT);
+        do {
+            compileRecovering(context, compileVarDecl, skipDeclaration);
+        } while (context->lookAhead->tokenType == TK_IDENT);
 
-        compileBlock3();
-    } else compileBlock3();
+        compileBlock4(context);
+    } else compileBlock4(context);
 }
 
-void compileBlock3(void) {
+void compileVarDecl(CompileContext *context) {
     Object *varObj;
     Type *varType;
 
-    if (lookAhead->tokenType == KW_VAR) {
-        eat(KW_VAR);
-
-        do {
-            eat(TK_IDENT);
-
-            checkFreshIdent(currentToken->string);
-            varObj = createVariableObject(currentToken->string);
+    eat(context, TK_IDENT);
 
-            eat(SB_COLON);
-            varType = compileType();
+    checkFreshIdent(context, context->currentToken->atom);
+    varObj = createVariableObject(context->symtab, context->currentToken->atom);
+    openNode(context->ast, AST_VAR_DECL, 0, context->currentToken->offset, context->currentToken->atom);
 
-            varObj->varAttrs->type = varType;
-            declareObject(varObj);
+    eat(context, SB_COLON);
+    varType = compileType(context);
 
-            eat(SB_SEMICOLON);
-        } while (lookAhead->tokenType == TK_IDENT);
+    varObj->varAttrs->type = varType;
+    declareObject(context->symtab, varObj);
+    closeNode(context->ast);
 
-        compileBlock4();
-    } else compileBlock4();
+    eat(context, SB_SEMICOLON);
 }
 
-void compileBlock4(void) {
-    compileSubDecls();
-    compileBlock5();
+void compileBlock4(CompileContext *context) {
+    compileSubDecls(context);
+    compileBlock5(context);
 }
 
-void compileBlock5(void) {
-    eat(KW_BEGIN);
-    compileStatements();
-    eat(KW_END);
+void compileBlock5(CompileContext *context) {
+    openNode(context->ast, AST_GROUP, 0, context->lookAhead->offset, 0);
+    eat(context, KW_BEGIN);
+    compileStatements(context);
+    eat(context, KW_END);
+    closeNode(context->ast);
 }
 
-void compileSubDecls(void) {
-    while ((lookAhead->tokenType == KW_FUNCTION) || (lookAhead->tokenType == KW_PROCEDURE)) {
-        if (lookAhead->tokenType == KW_FUNCTION)
-            compileFuncDecl();
-        else compileProcDecl();
+void compileSubDecls(CompileContext *context) {
+    while ((context->lookAhead->tokenType == KW_FUNCTION) || (context->lookAhead->tokenType == KW_PROCEDURE)) {
+        if (context->lookAhead->tokenType == KW_FUNCTION)
+            compileRecovering(context, compileFuncDecl, skipSubDecl);
+        else compileRecovering(context, compileProcDecl, skipSubDecl);
     }
 }
 
-void compileFuncDecl(void) {
+void compileFuncDecl(CompileContext *context) {
     Object *funcObj;
-    Type *returnType;
 
-    eat(KW_FUNCTION);
-    eat(TK_IDENT);
+    eat(context, KW_FUNCTION);
+    eat(context, TK_IDENT);
 
-    checkFreshIdent(currentToken->string);
-    funcObj = createFunctionObject(currentToken->string);
-    declareObject(funcObj);
+    checkFreshIdent(context, context->currentToken->atom);
+    funcObj = createFunctionObject(context->symtab, context->currentToken->atom);
+    declareObject(context->symtab, funcObj);
+    openNode(context->ast, AST_FUNC_DECL, 0, context->currentToken->offset, context->currentToken->atom);
 
-    enterBlock(funcObj->funcAttrs->scope);
+    enterBlock(context->symtab, funcObj->funcAttrs->scope);
 
-    compileParams();
+    compileRecovering(context, compileFuncHeading, skipHeading);
+    if (funcObj->funcAttrs->returnType == NULL)
+        funcObj->funcAttrs->returnType = makeErrorType();
 
-    eat(SB_COLON);
-    returnType = compileBasicType();
-    funcObj->funcAttrs->returnType = returnType;
+    compileBlock(context);
+    eat(context, SB_SEMICOLON);
+
+    exitBlock(context->symtab);
+    closeNode(context->ast);
+}
 
-    eat(SB_SEMICOLON);
-    compileBlock();
-    eat(SB_SEMICOLON);
+/* The parameters and return type of the function of the current scope */
+void compileFuncHeading(CompileContext *context) {
+    Object *funcObj = context->symtab->currentScope->owner;
+    Type *returnType;
+
+    compileParams(context);
 
-    exitBlock();
+    eat(context, SB_COLON);
+    returnType = compileBasicType(context);
+    funcObj->funcAttrs->returnType = returnType;
+
+    eat(context, SB_SEMICOLON);
 }
 
-void compileProcDecl(void) {
+void compileProcDecl(CompileContext *context) {
     Object *procObj;
 
-    eat(KW_PROCEDURE);
-    eat(TK_IDENT);
+    eat(context, KW_PROCEDURE);
+    eat(context, TK_IDENT);
 
-    checkFreshIdent(currentToken->string);
-    procObj = createProcedureObject(currentToken->string);
-    declareObject(procObj);
+    checkFreshIdent(context, context->currentToken->atom);
+    procObj = createProcedureObject(context->symtab, context->currentToken->atom);
+    declareObject(context->symtab, procObj);
+    openNode(context->ast, AST_PROC_DECL, 0, context->currentToken->offset, context->currentToken->atom);
 
-    enterBlock(procObj->procAttrs->scope);
+    enterBlock(context->symtab, procObj->procAttrs->scope);
 
-    compileParams();
+    compileRecovering(context, compileProcHeading, skipHeading);
 
-    eat(SB_SEMICOLON);
-    compileBlock();
-    eat(SB_SEMICOLON);
+    compileBlock(context);
+    eat(context, SB_SEMICOLON);
 
-    exitBlock();
+    exitBlock(context->symtab);
+    closeNode(context->ast);
 }
 
-ConstantValue *compileUnsignedConstant(void) {
-    ConstantValue *constValue;
+/* The parameters of the procedure of the current scope */
+void compileProcHeading(CompileContext *context) {
+    compileParams(context);
+    eat(context, SB_SEMICOLON);
+}
+
+ConstantValue *compileUnsignedConstant(CompileContext *context) {
+    ConstantValue *constValue = NULL;
     Object *obj;
 
-    switch (lookAhead->tokenType) {
+    switch (context->lookAhead->tokenType) {
         case TK_NUMBER:
-            eat(TK_NUMBER);
-            constValue = makeIntConstant(currentToken->value);
+            eat(context, TK_NUMBER);
+            constValue = makeIntConstant(context->currentToken->value);
+            addLeaf(context->ast, AST_NUMBER, context->currentToken->offset, (uint32_t) context->currentToken->value);
             break;
         case TK_IDENT:
-            eat(TK_IDENT);
+            eat(context, TK_IDENT);
 
-            obj = checkDeclaredConstant(currentToken->string);
+            obj = checkDeclaredConstant(context, context->currentToken->atom);
             constValue = duplicateConstantValue(obj->constAttrs->value);
+            addLeaf(context->ast, AST_NAME, context->currentToken->offset, context->currentToken->atom);
 
             break;
         case TK_CHAR:
-            eat(TK_CHAR);
-            constValue = makeCharConstant(currentToken->string[0]);
+            eat(context, TK_CHAR);
+            constValue = makeCharConstant(context->currentToken->string[0]);
+            addLeaf(context->ast, AST_CHAR, context->currentToken->offset, (unsigned char) context->currentToken->string[0]);
             break;
         default:
-            error(ERR_INVALID_CONSTANT, lookAhead->lineNo, lookAhead->colNo);
+            error(ERR_INVALID_CONSTANT, context->lookAhead->offset);
             break;
     }
     return constValue;
 }
 
-ConstantValue *compileConstant(void) {
-    ConstantValue *constValue;
+ConstantValue *compileConstant(CompileContext *context) {
+    ConstantValue *constValue = NULL;
 
-    switch (lookAhead->tokenType) {
+    switch (context->lookAhead->tokenType) {
         case SB_PLUS:
-            eat(SB_PLUS);
-            constValue = compileConstant2();
+            eat(context, SB_PLUS);
+            constValue = compileConstant2(context);
             break;
         case SB_MINUS:
-            eat(SB_MINUS);
-            constValue = compileConstant2();
+            openNode(context->ast, AST_UNARY, SB_MINUS, context->lookAhead->offset, 0);
+            eat(context, SB_MINUS);
+            constValue = compileConstant2(context);
             constValue->intValue = -constValue->intValue;
+            closeNode(context->ast);
             break;
         case TK_CHAR:
-            eat(TK_CHAR);
-            constValue = makeCharConstant(currentToken->string[0]);
+            eat(context, TK_CHAR);
+            constValue = makeCharConstant(context->currentToken->string[0]);
+            addLeaf(context->ast, AST_CHAR, context->currentToken->offset, (unsigned char) context->currentToken->string[0]);
             break;
         default:
-            constValue = compileConstant2();
+            constValue = compileConstant2(context);
             break;
     }
     return constValue;
 }
 
-ConstantValue *compileConstant2(void) {
-    ConstantValue *constValue;
+ConstantValue *compileConstant2(CompileContext *context) {
+    ConstantValue *constValue = NULL;
     Object *obj;
 
-    switch (lookAhead->tokenType) {
+    switch (context->lookAhead->tokenType) {
         case TK_NUMBER:
-            eat(TK_NUMBER);
-            constValue = makeIntConstant(currentToken->value);
+            eat(context, TK_NUMBER);
+            constValue = makeIntConstant(context->currentToken->value);
+            addLeaf(context->ast, AST_NUMBER, context->currentToken->offset, (uint32_t) context->currentToken->value);
             break;
         case TK_IDENT:
-            eat(TK_IDENT);
-            obj = checkDeclaredConstant(currentToken->string);
-            if (obj->constAttrs->value->type == TP_INT)
+            eat(context, TK_IDENT);
+            obj = checkDeclaredConstant(context, context->currentToken->atom);
+            addLeaf(context->ast, AST_NAME, context->currentToken->offset, context->currentToken->atom);
+            if ((obj->constAttrs->value->type == TP_INT) || (obj->constAttrs->value->type == TP_ERROR))
                 constValue = duplicateConstantValue(obj->constAttrs->value);
-            else
-                error(ERR_UNDECLARED_INT_CONSTANT, currentToken->lineNo, currentToken->colNo);
+            else {
+                recoverableError(ERR_UNDECLARED_INT_CONSTANT, context->currentToken->offset);
+                constValue = makeErrorConstant();
+            }
             break;
         default:
-            error(ERR_INVALID_CONSTANT, lookAhead->lineNo, lookAhead->colNo);
+            error(ERR_INVALID_CONSTANT, context->lookAhead->offset);
             break;
     }
     return constValue;
 }
 
-Type *compileType(void) {
-    Type *type;
+Type *compileType(CompileContext *context) {
+    Type *type = NULL;
     Type *elementType;
     int arraySize;
     Object *obj;
+    SourceOffset offset;
 
-    switch (lookAhead->tokenType) {
+    switch (context->lookAhead->tokenType) {
         case KW_INTEGER:
-            eat(KW_INTEGER);
+            eat(context, KW_INTEGER);
             type = makeIntType();
+            addLeaf(context->ast, AST_INT_TYPE, context->currentToken->offset, 0);
             break;
         case KW_CHAR:
-            eat(KW_CHAR);
+            eat(context, KW_CHAR);
             type = makeCharType();
+            addLeaf(context->ast, AST_CHAR_TYPE, context->currentToken->offset, 0);
             break;
         case KW_ARRAY:
-            eat(KW_ARRAY);
-            eat(SB_LSEL);
-            eat(TK_NUMBER);
+            offset = context->lookAhead->offset;
+            eat(context, KW_ARRAY);
+            eat(context, SB_LSEL);
+            eat(context, TK_NUMBER);
 
-            arraySize = currentToken->value;
+            arraySize = context->currentToken->value;
+            openNode(context->ast, AST_ARRAY_TYPE, 0, offset, (uint32_t) arraySize);
 
-            eat(SB_RSEL);
-            eat(KW_OF);
-            elementType = compileType();
+            eat(context, SB_RSEL);
+            eat(context, KW_OF);
+            elementType = compileType(context);
             type = makeArrayType(arraySize, elementType);
+            closeNode(context->ast);
             break;
         case TK_IDENT:
-            eat(TK_IDENT);
-            obj = checkDeclaredType(currentToken->string);
+            eat(context, TK_IDENT);
+            obj = checkDeclaredType(context, context->currentToken->atom);
             type = duplicateType(obj->typeAttrs->actualType);
+            addLeaf(context->ast, AST_NAMED_TYPE, context->currentToken->offset, context->currentToken->atom);
             break;
         default:
-            error(ERR_INVALID_TYPE, lookAhead->lineNo, lookAhead->colNo);
+            error(ERR_INVALID_TYPE, context->lookAhead->offset);
             break;
     }
     return type;
 }
 
-Type *compileBasicType(void) {
-    Type *type;
+Type *compileBasicType(CompileContext *context) {
+    Type *type = NULL;
 
-    switch (lookAhead->tokenType) {
+    switch (context->lookAhead->tokenType) {
         case KW_INTEGER:
-            eat(KW_INTEGER);
+            eat(context, KW_INTEGER);
             type = makeIntType();
+            addLeaf(context->ast, AST_INT_TYPE, context->currentToken->offset, 0);
             break;
         case KW_CHAR:
-            eat(KW_CHAR);
+            eat(context, KW_CHAR);
             type = makeCharType();
+            addLeaf(context->ast, AST_CHAR_TYPE, context->currentToken->offset, 0);
             break;
         default:
-            error(ERR_INVALID_BASICTYPE, lookAhead->lineNo, lookAhead->colNo);
+            error(ERR_INVALID_BASICTYPE, context->lookAhead->offset);
             break;
     }
     return type;
 }
 
-void compileParams(void) {
-    if (lookAhead->tokenType == SB_LPAR) {
-        eat(SB_LPAR);
-        compileParam();
-        while (lookAhead->tokenType == SB_SEMICOLON) {
-            eat(SB_SEMICOLON);
-            compileParam();
+void compileParams(CompileContext *context) {
+    if (context->lookAhead->tokenType == SB_LPAR) {
+        eat(context, SB_LPAR);
+        compileParam(context);
+        while (context->lookAhead->tokenType == SB_SEMICOLON) {
+            eat(context, SB_SEMICOLON);
+            compileParam(context);
         }
-        eat(SB_RPAR);
+        eat(context, SB_RPAR);
     }
 }
 
-void compileParam(void) {
+void compileParam(CompileContext *context) {
     Object *param;
     Type *type;
-    enum ParamKind paramKind;
+    enum ParamKind paramKind = PARAM_VALUE;
 
-    switch (lookAhead->tokenType) {
+    switch (context->lookAhead->tokenType) {
         case TK_IDENT:
             paramKind = PARAM_VALUE;
             break;
         case KW_VAR:
-            eat(KW_VAR);
+            eat(context, KW_VAR);
             paramKind = PARAM_REFERENCE;
             break;
         default:
-            error(ERR_INVALID_PARAMETER, lookAhead->lineNo, lookAhead->colNo);
+            error(ERR_INVALID_PARAMETER, context->lookAhead->offset);
             break;
     }
 
-    eat(TK_IDENT);
-    checkFreshIdent(currentToken->string);
-    param = createParameterObject(currentToken->string, paramKind, symtab->currentScope->owner);
-    eat(SB_COLON);
-    type = compileBasicType();
+    eat(context, TK_IDENT);
+    checkFreshIdent(context, context->currentToken->atom);
+    param = createParameterObject(context->currentToken->atom, paramKind, context->symtab->currentScope->owner);
+    openNode(context->ast, AST_PARAM, (uint8_t) paramKind, context->currentToken->offset, context->currentToken->atom);
+    eat(context, SB_COLON);
+    type = compileBasicType(context);
     param->paramAttrs->type = type;
-    declareObject(param);
+    declareObject(context->symtab, param);
+    closeNode(context->ast);
 }
 
-void compileStatements(void) {
-    compileStatement();
-    while (lookAhead->tokenType == SB_SEMICOLON) {
-        eat(SB_SEMICOLON);
-        compileStatement();
+void compileStatements(CompileContext *context) {
+    compileRecovering(context, compileStatement, skipStatement);
+    while (context->lookAhead->tokenType == SB_SEMICOLON) {
+        eat(context, SB_SEMICOLON);
+        compileRecovering(context, compileStatement, skipStatement);
     }
 }
 
-void compileStatement(void) {
-    switch (lookAhead->tokenType) {
+void compileStatement(CompileContext *context) {
+    switch (context->lookAhead->tokenType) {
         case TK_IDENT:
-            compileAssignSt();
+            compileAssignSt(context);
             break;
         case KW_CALL:
-            compileCallSt();
+            compileCallSt(context);
             break;
         case KW_BEGIN:
-            compileGroupSt();
+            compileGroupSt(context);
             break;
         case KW_IF:
-            compileIfSt();
+            compileIfSt(context);
             break;
         case KW_WHILE:
-            compileWhileSt();
+            compileWhileSt(context);
             break;
         case KW_FOR:
-            compileForSt();
+            compileForSt(context);
             break;
             // EmptySt needs to check FOLLOW tokens
         case SB_SEMICOLON:
         case KW_END:
         case KW_ELSE:
+            addLeaf(context->ast, AST_EMPTY, context->lookAhead->offset, 0);
             break;
             // Error occurs
         default:
-            error(ERR_INVALID_STATEMENT, lookAhead->lineNo, lookAhead->colNo);
+            error(ERR_INVALID_STATEMENT, context->lookAhead->offset);
             break;
     }
 }
 
-Type *compileLValue(void) {
+Type *compileLValue(CompileContext *context) {
     Object *obj;
     Type *type = NULL;
 
-    eat(TK_IDENT);
+    eat(context, TK_IDENT);
     // check if the identifier is a function identifier, or a variable identifier, or a parameter
-    obj = checkDeclaredLValueIdent(currentToken->string);
+    obj = checkDeclaredLValueIdent(context, context->currentToken->atom);
     if (obj->kind == OBJ_VARIABLE) {
-        if (obj->varAttrs->type->typeClass == TP_ARRAY) type = compileIndexes(obj->varAttrs->type);
-        else type = obj->varAttrs->type;
+        if ((obj->varAttrs->type->typeClass == TP_ARRAY) || (obj->varAttrs->type->typeClass == TP_ERROR)) {
+            openNode(context->ast, AST_INDEX, 0, context->currentToken->offset, context->currentToken->atom);
+            type = compileIndexes(context, obj->varAttrs->type);
+            closeNode(context->ast);
+            return type;
+        }
+        type = obj->varAttrs->type;
     } else if (obj->kind == OBJ_FUNCTION)
         type = obj->funcAttrs->returnType;
     else type = obj->paramAttrs->type;
+    addLeaf(context->ast, AST_NAME, context->currentToken->offset, context->currentToken->atom);
     return type;
 }
 
-void compileAssignSt(void) {
+void compileAssignSt(CompileContext *context) {
+    Type *t1;
 
-    Type *t1 = compileLValue();
-    eat(SB_ASSIGN);
-    checkTypeEquality(t1, compileExpression());
+    openNode(context->ast, AST_ASSIGN, 0, context->lookAhead->offset, 0);
+    t1 = compileLValue(context);
+    eat(context, SB_ASSIGN);
+    checkTypeEquality(context, t1, compileExpression(context));
+    closeNode(context->ast);
 }
 
-void compileCallSt(void) {
+void compileCallSt(CompileContext *context) {
     Object *proc;
 
-    eat(KW_CALL);
-    eat(TK_IDENT);
-    proc = checkDeclaredProcedure(currentToken->string);
-    compileArguments(proc->procAttrs->paramList);
+    eat(context, KW_CALL);
+    eat(context, TK_IDENT);
+    proc = checkDeclaredProcedure(context, context->currentToken->atom);
+    openNode(context->ast, AST_CALL, 0, context->currentToken->offset, context->currentToken->atom);
+    if (proc->isError)
+        compileAnyArguments(context);
+    else compileArguments(context, proc->procAttrs->paramList);
+    closeNode(context->ast);
 }
 
-void compileGroupSt(void) {
-    eat(KW_BEGIN);
-    compileStatements();
-    eat(KW_END);
+void compileGroupSt(CompileContext *context) {
+    openNode(context->ast, AST_GROUP, 0, context->lookAhead->offset, 0);
+    eat(context, KW_BEGIN);
+    compileStatements(context);
+    eat(context, KW_END);
+    closeNode(context->ast);
 }
 
-void compileIfSt(void) {
-    eat(KW_IF);
-    compileCondition();
-    eat(KW_THEN);
-    compileStatement();
-    if (lookAhead->tokenType == KW_ELSE)
-        compileElseSt();
+void compileIfSt(CompileContext *context) {
+    openNode(context->ast, AST_IF, 0, context->lookAhead->offset, 0);
+    eat(context, KW_IF);
+    compileCondition(context);
+    eat(context, KW_THEN);
+    compileStatement(context);
+    if (context->lookAhead->tokenType == KW_ELSE)
+        compileElseSt(context);
+    closeNode(context->ast);
 }
 
-void compileElseSt(void) {
-    eat(KW_ELSE);
-    compileStatement();
+void compileElseSt(CompileContext *context) {
+    eat(context, KW_ELSE);
+    compileStatement(context);
 }
 
-void compileWhileSt(void) {
-    eat(KW_WHILE);
-    compileCondition();
-    eat(KW_DO);
-    compileStatement();
+void compileWhileSt(CompileContext *context) {
+    openNode(context->ast, AST_WHILE, 0, context->lookAhead->offset, 0);
+    eat(context, KW_WHILE);
+    compileCondition(context);
+    eat(context, KW_DO);
+    compileStatement(context);
+    closeNode(context->ast);
 }
 
-void compileForSt(void) {
+void compileForSt(CompileContext *context) {
+    SourceOffset offset = context->lookAhead->offset;
 
-    eat(KW_FOR);
-    eat(TK_IDENT);
+    eat(context, KW_FOR);
+    eat(context, TK_IDENT);
+    openNode(context->ast, AST_FOR, 0, offset, context->currentToken->atom);
 
     // check if the identifier is a variable
-    Object *var = checkDeclaredVariable(currentToken->string);
-    //  checkBasicType(var->varAttrs->type);
+    Object *var = checkDeclaredVariable(context, context->currentToken->atom);
+    //  checkBasicType(context, var->varAttrs->type);
     Type *t1 = var->varAttrs->type;
-    eat(SB_ASSIGN);
-    checkTypeEquality(t1, compileExpression());
-    eat(KW_TO);
-    checkTypeEquality(t1, compileExpression());
-    eat(KW_DO);
-    compileStatement();
+    eat(context, SB_ASSIGN);
+    checkTypeEquality(context, t1, compileExpression(context));
+    eat(context, KW_TO);
+    checkTypeEquality(context, t1, compileExpression(context));
+    eat(context, KW_DO);
+    compileStatement(context);
+    closeNode(context->ast);
 }
 
-void compileArgument(Object *param) {
+void compileArgument(CompileContext *context, Object *param) {
     if (param->paramAttrs->kind == PARAM_REFERENCE) {
-        if (lookAhead->tokenType == TK_IDENT) {
-            checkDeclaredLValueIdent(lookAhead->string);
+        if (context->lookAhead->tokenType == TK_IDENT) {
+            checkDeclaredLValueIdent(context, context->lookAhead->atom);
         } else {
-            error(ERR_TYPE_INCONSISTENCY, lookAhead->lineNo, lookAhead->colNo);
+            error(ERR_TYPE_INCONSISTENCY, context->lookAhead->offset);
         }
     }
-    checkTypeEquality(compileExpression(), param->paramAttrs->type);
+    checkTypeEquality(context, compileExpression(context), param->paramAttrs->type);
 }
 
-void compileArguments(ObjectNode *paramList) {
+void compileArguments(CompileContext *context, ObjectNode *paramList) {
     //   printf("goi t %d\n",currentToken->lineNo);
     int t = 1;
     if (paramList != NULL && paramList->object != NULL) t = 2;
-    switch (lookAhead->tokenType) {
+    switch (context->lookAhead->tokenType) {
         case SB_LPAR:
-            if(paramList == NULL) error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
-            eat(SB_LPAR);
+            if(paramList == NULL) error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, context->currentToken->offset);
+            eat(context, SB_LPAR);
             ObjectNode *param = paramList;
-            compileArgument(param->object);
-            while (lookAhead->tokenType == SB_COMMA) {
-                eat(SB_COMMA);
+            compileArgument(context, param->object);
+            while (context->lookAhead->tokenType == SB_COMMA) {
+                eat(context, SB_COMMA);
                 param = param->next;
                 if (param == NULL)
-                    error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
-                else compileArgument(param->object);
+                    error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, context->currentToken->offset);
+                else compileArgument(context, param->object);
             }
 
             if (param->next != NULL)
-                error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
-            eat(SB_RPAR);
+                error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, context->currentToken->offset);
+            eat(context, SB_RPAR);
             return;
             // Check FOLLOW set
         case SB_TIMES:
@@ -535,90 +834,110 @@ void compileArguments(ObjectNode *paramList) {
         case KW_END:
         case KW_ELSE:
         case KW_THEN:
-            if (t == 2) error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
+            if (t == 2) error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, context->currentToken->offset);
             break;
         default:
-            error(ERR_INVALID_ARGUMENTS, lookAhead->lineNo, lookAhead->colNo);
+            error(ERR_INVALID_ARGUMENTS, context->lookAhead->offset);
     }
 
 }
 
-void compileCondition(void) {
-    Type *type = compileExpression();
+/* The arguments of an error object, which takes any */
+void compileAnyArguments(CompileContext *context) {
+    if (context->lookAhead->tokenType == SB_LPAR) {
+        eat(context, SB_LPAR);
+        compileExpression(context);
+        while (context->lookAhead->tokenType == SB_COMMA) {
+            eat(context, SB_COMMA);
+            compileExpression(context);
+        }
+        eat(context, SB_RPAR);
+    }
+}
+
+void compileCondition(CompileContext *context) {
+    Type *type = compileExpression(context);
 
-    switch (lookAhead->tokenType) {
+    openNodeAround(context->ast, AST_COMPARE, (uint8_t) context->lookAhead->tokenType, context->lookAhead->offset);
+    switch (context->lookAhead->tokenType) {
         case SB_EQ:
-            eat(SB_EQ);
+            eat(context, SB_EQ);
             break;
         case SB_NEQ:
-            eat(SB_NEQ);
+            eat(context, SB_NEQ);
             break;
         case SB_LE:
-            eat(SB_LE);
+            eat(context, SB_LE);
             break;
         case SB_LT:
-            eat(SB_LT);
+            eat(context, SB_LT);
             break;
         case SB_GE:
-            eat(SB_GE);
+            eat(context, SB_GE);
             break;
         case SB_GT:
-            eat(SB_GT);
+            eat(context, SB_GT);
             break;
         default:
-            error(ERR_INVALID_COMPARATOR, lookAhead->lineNo, lookAhead->colNo);
+            error(ERR_INVALID_COMPARATOR, context->lookAhead->offset);
     }
 
-    checkTypeEquality(compileExpression(), type);
+    checkTypeEquality(context, compileExpression(context), type);
+    closeNode(context->ast);
 }
 
-Type *compileExpression(void) {
+Type *compileExpression(CompileContext *context) {
     Type *type;
 
-    switch (lookAhead->tokenType) {
+    switch (context->lookAhead->tokenType) {
         case SB_PLUS:
-            eat(SB_PLUS);
-            type = compileExpression2();
-            checkIntType(type);
+            openNode(context->ast, AST_UNARY, SB_PLUS, context->lookAhead->offset, 0);
+            eat(context, SB_PLUS);
+            type = compileExpression2(context);
+            checkIntType(context, type);
+            closeNode(context->ast);
             break;
         case SB_MINUS:
-            eat(SB_MINUS);
-            type = compileExpression2();
-            checkIntType(type);
+            openNode(context->ast, AST_UNARY, SB_MINUS, context->lookAhead->offset, 0);
+            eat(context, SB_MINUS);
+            type = compileExpression2(context);
+            checkIntType(context, type);
+            closeNode(context->ast);
             break;
         default:
-            type = compileExpression2();
+            type = compileExpression2(context);
     }
     return type;
 }
 
-Type *compileExpression2(void) {
-    Type *type;
-
-    type = compileTerm();
-    compileExpression3();
-
-    return type;
+/* The binary operators. All are left associative, and a higher
+ * precedence binds tighter. */
+typedef struct {
+    TokenType tokenType;
+    int precedence;
+} BinaryOperator;
+
+#define MAX_PRECEDENCE 2
+
+BinaryOperator binaryOperators[] = {
+    {SB_PLUS, 1},
+    {SB_MINUS, 1},
+    {SB_TIMES, 2},
+    {SB_SLASH, 2}
+};
+
+int operatorPrecedence(TokenType tokenType) {
+    int i;
+
+    for (i = 0; i < (int) (sizeof(binaryOperators) / sizeof(BinaryOperator)); i++)
+        if (binaryOperators[i].tokenType == tokenType)
+            return binaryOperators[i].precedence;
+    return 0;
 }
 
-
-void compileExpression3(void) {
-    Type *type;
-
-    switch (lookAhead->tokenType) {
-        case SB_PLUS:
-            eat(SB_PLUS);
-            type = compileTerm();
-            checkIntType(type);
-            compileExpression3();
-            break;
-        case SB_MINUS:
-            eat(SB_MINUS);
-            type = compileTerm();
-            checkIntType(type);
-            compileExpression3();
-            break;
-            // check the FOLLOW set
+/* Whether tokenType may come right after an expression */
+int isExpressionFollow(TokenType tokenType) {
+    switch (tokenType) {
         case KW_TO:
         case KW_DO:
         case SB_RPAR:
@@ -634,146 +953,305 @@ void compileExpression3(void) {
         case KW_END:
         case KW_ELSE:
         case KW_THEN:
-            break;
+            return 1;
         default:
-            error(ERR_INVALID_EXPRESSION, lookAhead->lineNo, lookAhead->colNo);
+            return 0;
     }
 }
 
-Type *compileTerm(void) {
+/* Compiles factors joined by binary operators, by precedence climbing
+ * in a loop. As operators are left associative, an operator is closed
+ * as soon as its right operand ends, before the next operator is looked
+ * at, so at most one operator per precedence is open at a time and any
+ * number of operators take the same stack space. As with the grammar,
+ * the type of the expression is that of its first factor, and each
+ * operand after an operator is checked to be an integer. */
+Type *compileExpression2(CompileContext *context) {
+    int open[MAX_PRECEDENCE + 1];        /* whether an operator of each precedence is open */
+    Type *operands[MAX_PRECEDENCE + 1];  /* the right operand of that operator */
     Type *type;
+    TokenType tokenType;
+    int precedence, level;
+
+    for (level = 0; level <= MAX_PRECEDENCE; level++)
+        open[level] = 0;
+    type = compileFactor(context);
+
+    for (;;) {
+        // the operand just compiled ends the operators of higher
+        // precedence than the one after it
+        tokenType = context->lookAhead->tokenType;
+        precedence = operatorPrecedence(tokenType);
+        for (level = MAX_PRECEDENCE; level > precedence; level--) {
+            if (open[level]) {
+                checkIntType(context, operands[level]);
+                closeNode(context->ast);
+                open[level] = 0;
+            }
+            // an operand followed by neither an operator nor the end of
+            // the expression is reported once the tightest operator is
+            // closed, as a bad term
+            if ((level == MAX_PRECEDENCE) && (precedence == 0) && !isExpressionFollow(tokenType))
+                error(ERR_INVALID_TERM, context->lookAhead->offset);
+        }
+        if (precedence == 0)
+            break;
 
-    type = compileFactor();
-    compileTerm2();
+        // and a left associative operator ends the one of its own
+        if (open[precedence]) {
+            checkIntType(context, operands[precedence]);
+            closeNode(context->ast);
+        }
+        openNodeAround(context->ast, AST_BINARY, tokenType, context->lookAhead->offset);
+        eat(context, tokenType);
+        open[precedence] = 1;
+        operands[precedence] = compileFactor(context);
+    }
 
     return type;
 }
 
-void compileTerm2(void) {
-    Type *type;
-
-    switch (lookAhead->tokenType) {
-        case SB_TIMES:
-            eat(SB_TIMES);
-            type = compileFactor();
-            checkIntType(type);
-            compileTerm2();
-            break;
-        case SB_SLASH:
-            eat(SB_SLASH);
-            type = compileFactor();
-            checkIntType(type);
-            compileTerm2();
-            break;
-            // check the FOLLOW set
-        case SB_PLUS:
-        case SB_MINUS:
-        case KW_TO:
-        case KW_DO:
-        case SB_RPAR:
-        case SB_COMMA:
-        case SB_EQ:
-        case SB_NEQ:
-        case SB_LE:
-        case SB_LT:
-        case SB_GE:
-        case SB_GT:
-        case SB_RSEL:
-        case SB_SEMICOLON:
-        case KW_END:
-        case KW_ELSE:
-        case KW_THEN:
-            break;
-        default:
-            error(ERR_INVALID_TERM, lookAhead->lineNo, lookAhead->colNo);
-    }
-}
-
-Type *compileFactor(void) {
+Type *compileFactor(CompileContext *context) {
 
     Object *obj;
-    Type *type;
+    Type *type = NULL;
 
-    switch (lookAhead->tokenType) {
+    switch (context->lookAhead->tokenType) {
         case TK_NUMBER:
-            eat(TK_NUMBER);
+            eat(context, TK_NUMBER);
+            addLeaf(context->ast, AST_NUMBER, context->currentToken->offset, (uint32_t) context->currentToken->value);
             return makeIntType();
         case TK_CHAR:
-            eat(TK_CHAR);
+            eat(context, TK_CHAR);
+            addLeaf(context->ast, AST_CHAR, context->currentToken->offset, (unsigned char) context->currentToken->string[0]);
             return makeCharType();
         case TK_IDENT:
-            eat(TK_IDENT);
+            eat(context, TK_IDENT);
             // check if the identifier is declared
-            obj = checkDeclaredIdent(currentToken->string);
+            obj = checkDeclaredIdent(context, context->currentToken->atom);
 
             switch (obj->kind) {
                 case OBJ_CONSTANT:
+                    addLeaf(context->ast, AST_NAME, context->currentToken->offset, context->currentToken->atom);
                     switch (obj->constAttrs->value->type) {
                         case TP_INT:
                             return makeIntType();
 
                         case TP_CHAR:
                             return makeCharType();
+
+                        case TP_ERROR:
+                            return makeErrorType();
                     }
                     break;
                 case OBJ_VARIABLE:
-                    if (obj->varAttrs->type->typeClass != TP_ARRAY) type = obj->varAttrs->type;
-                    else return compileIndexes(obj->varAttrs->type);
+                    // an undeclared identifier may be called or indexed
+                    if (obj->isError && (context->lookAhead->tokenType == SB_LPAR)) {
+                        openNode(context->ast, AST_CALL, 0, context->currentToken->offset, context->currentToken->atom);
+                        compileAnyArguments(context);
+                        closeNode(context->ast);
+                        type = obj->varAttrs->type;
+                    } else if ((obj->varAttrs->type->typeClass != TP_ARRAY) &&
+                               (obj->varAttrs->type->typeClass != TP_ERROR)) {
+                        addLeaf(context->ast, AST_NAME, context->currentToken->offset, context->currentToken->atom);
+                        type = obj->varAttrs->type;
+                    } else {
+                        openNode(context->ast, AST_INDEX, 0, context->currentToken->offset, context->currentToken->atom);
+                        type = compileIndexes(context, obj->varAttrs->type);
+                        closeNode(context->ast);
+                    }
                     break;
                 case OBJ_PARAMETER:
+                    addLeaf(context->ast, AST_NAME, context->currentToken->offset, context->currentToken->atom);
                     type = obj->paramAttrs->type;
                     break;
                 case OBJ_FUNCTION:
+                    openNode(context->ast, AST_CALL, 0, context->currentToken->offset, context->currentToken->atom);
                     type = obj->funcAttrs->returnType;
-                    compileArguments(obj->funcAttrs->paramList);
+                    compileArguments(context, obj->funcAttrs->paramList);
+                    closeNode(context->ast);
                     break;
                 default:
-                    error(ERR_INVALID_FACTOR, currentToken->lineNo, currentToken->colNo);
+                    error(ERR_INVALID_FACTOR, context->currentToken->offset);
                     break;
             }
             break;
         default:
-            error(ERR_INVALID_FACTOR, lookAhead->lineNo, lookAhead->colNo);
+            error(ERR_INVALID_FACTOR, context->lookAhead->offset);
     }
 
     return type;
 }
 
-Type *compileIndexes(Type *arrayType) {
+Type *compileIndexes(CompileContext *context, Type *arrayType) {
     Type *type = arrayType;
-    while (lookAhead->tokenType == SB_LSEL) {
-        eat(SB_LSEL);
-        checkIntType(compileExpression());
+
+    // the error type takes any number of indexes
+    if (arrayType->typeClass == TP_ERROR) {
+        while (context->lookAhead->tokenType == SB_LSEL) {
+            eat(context, SB_LSEL);
+            checkIntType(context, compileExpression(context));
+            eat(context, SB_RSEL);
+        }
+        return type;
+    }
+    while (context->lookAhead->tokenType == SB_LSEL) {
+        eat(context, SB_LSEL);
+        checkIntType(context, compileExpression(context));
         arrayType = arrayType->elementType;
-        eat(SB_RSEL);
+        eat(context, SB_RSEL);
         type = arrayType;
         if (type->typeClass != TP_ARRAY) {
             break;
-        }else if(lookAhead->tokenType != SB_LSEL)
-            error(ERR_DIMENSIONAL_OF_ARRAY, currentToken->lineNo, currentToken->colNo);
+        }else if(context->lookAhead->tokenType != SB_LSEL)
+            error(ERR_DIMENSIONAL_OF_ARRAY, context->currentToken->offset);
     }
-    if (lookAhead->tokenType == SB_LSEL) error(ERR_DIMENSIONAL_OF_ARRAY, currentToken->lineNo, currentToken->colNo);
+    if (context->lookAhead->tokenType == SB_LSEL) error(ERR_DIMENSIONAL_OF_ARRAY, context->currentToken->offset);
     return type;
 }
 
-int compile(char *fileName) {
-    if (openInputStream(fileName) == IO_ERROR)
-        return IO_ERROR;
+/* Compiles the input open in context->scanner into result. The errors
+ * found are logged, up to maxErrors of them, and the symbol table is
+ * dumped only when there are none. The names of the input are interned
+ * in a table of its own, which result keeps. */
+void compileInput(CompileContext *context, CompileResult *result) {
+    ErrorTrap trap;
+    ErrorLog log;
+    ErrorLog *previousLog;
+    AtomTable *previousAtoms;
+    FILE *dump;
+
+    result->diagnosticCount = 0;
+    result->diagnostics = NULL;
+    result->symtabDump = NULL;
+    result->symtabDumpLength = 0;
+    result->ast = NULL;
+    result->astDump = NULL;
+    result->astDumpLength = 0;
+
+    // without memory for a table of its own, the input uses the
+    // process-wide one
+    context->atoms = newAtomTable(context->scanner->input.size);
+    result->atoms = context->atoms;
+    previousAtoms = setAtomTable(context->atoms);
+
+    initErrorLog(&log, maxErrors);
+    previousLog = setErrorLog(&log);
+    resetTokenRing(context);
+    context->symtab = initSymTab();
+
+    // the tree is dumped once the input is read, with the places of
+    // its nodes
+    if (buildAst) {
+        context->ast = newAst();
+        keepLineIndex(context->scanner);
+    }
 
-    currentToken = NULL;
-    lookAhead = getValidToken();
+    armErrorTrap(&trap);
+    if (setjmp(trap.env) == 0) {
+        startTokens(context);
+        compileProgram(context);
+        finishAst(context->ast);
+        result->ast = context->ast;
+    } else {
+        logDiagnostic(&trap.diagnostic);
+        freeAst(context->ast);
+    }
+    disarmErrorTrap();
+    setErrorLog(previousLog);
+    context->ast = NULL;
+
+    if (result->ast != NULL) {
+        dump = open_memstream(&result->astDump, &result->astDumpLength);
+        setDebugOutput(dump);
+        printAst(result->ast, context->scanner);
+        setDebugOutput(NULL);
+        fclose(dump);
+    }
 
-    initSymTab();
+    if (log.count > 0) {
+        result->diagnosticCount = log.count;
+        result->diagnostics = log.diagnostics;
+    } else {
+        freeErrorLog(&log);
+        dump = open_memstream(&result->symtabDump, &result->symtabDumpLength);
+        setDebugOutput(dump);
+        printObject(context->symtab->program, 0);
+        setDebugOutput(NULL);
+        fclose(dump);
+    }
 
-    compileProgram();
+    cleanSymTab(context->symtab);
+    context->symtab = NULL;
+    resetTokenRing(context);
+    setAtomTable(previousAtoms);
+    context->atoms = NULL;
+}
 
-    printObject(symtab->program, 0);
+void printCompileResult(CompileResult *result) {
+    int i;
 
-    cleanSymTab();
+    for (i = 0; i < result->diagnosticCount; i ++)
+        printf("%d-%d:%s\n", result->diagnostics[i].lineNo, result->diagnostics[i].colNo,
+               result->diagnostics[i].message);
+    if (result->symtabDump != NULL)
+        fwrite(result->symtabDump, 1, result->symtabDumpLength, stdout);
+    if (result->astDump != NULL)
+        fwrite(result->astDump, 1, result->astDumpLength, stdout);
+}
 
-    free(currentToken);
-    free(lookAhead);
-    closeInputStream();
+int compile(char *fileName) {
+    CompileContext context;
+    CompileResult result;
+    Scanner source;
+    Scanner *previousSource;
+    int status;
+
+    status = openInputStream(&source, fileName);
+    if (status != IO_SUCCESS)
+        return status;
+    initCompileContext(&context, &source);
+    previousSource = setErrorSource(&source);
+
+    compileInput(&context, &result);
+    printCompileResult(&result);
+    free(result.diagnostics);
+    free(result.symtabDump);
+    freeAst(result.ast);
+    free(result.astDump);
+    freeAtomTable(result.atoms);
+
+    setErrorSource(previousSource);
+    closeInputStream(&source);
     return IO_SUCCESS;
+}
+
+CompileResult *compileBuffer(const char *buffer, size_t size) {
+    CompileResult *result;
+    CompileContext context;
+    Scanner source;
+    Scanner *previousSource;
+
+    if (size > MAX_SOURCE_SIZE)
+        return NULL;
+    result = (CompileResult *) malloc(sizeof(CompileResult));
+    initScanner(&source);
+    initCompileContext(&context, &source);
+    previousSource = setErrorSource(&source);
+    openInputMemory(&source, buffer, size);
+
+    compileInput(&context, result);
+
+    setErrorSource(previousSource);
+    closeInputStream(&source);
+    return result;
+}
 
+void freeCompileResult(CompileResult *result) {
+    free(result->diagnostics);
+    free(result->symtabDump);
+    freeAst(result->ast);
+    free(result->astDump);
+    freeAtomTable(result->atoms);
+    free(result);
 }
\ No newline at end of file
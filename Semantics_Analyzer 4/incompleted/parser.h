@@ -5,55 +5,111 @@
  */
 #ifndef __PARSER_H__
 #define __PARSER_H__
+#include <stddef.h>
 #include "token.h"
 #include "symtab.h"
+#include "error.h"
+#include "ast.h"
+#include "context.h"
 
-void scan(void);
-void eat(TokenType tokenType);
-
-void compileProgram(void);
-void compileBlock(void);
-void compileBlock2(void);
-void compileBlock3(void);
-void compileBlock4(void);
-void compileBlock5(void);
-void compileConstDecls(void);
-void compileConstDecl(void);
-void compileTypeDecls(void);
-void compileTypeDecl(void);
-void compileVarDecls(void);
-void compileVarDecl(void);
-void compileSubDecls(void);
-void compileFuncDecl(void);
-void compileProcDecl(void);
-ConstantValue* compileUnsignedConstant(void);
-ConstantValue* compileConstant(void);
-ConstantValue* compileConstant2(void);
-Type* compileType(void);
-Type* compileBasicType(void);
-void compileParams(void);
-void compileParam(void);
-void compileStatements(void);
-void compileStatement(void);
-Type* compileLValue(void);
-void compileAssignSt(void);
-void compileCallSt(void);
-void compileGroupSt(void);
-void compileIfSt(void);
-void compileElseSt(void);
-void compileWhileSt(void);
-void compileForSt(void);
-void compileArgument(Object* param);
-void compileArguments(ObjectNode* paramList);
-void compileCondition(void);
-Type* compileExpression(void);
-Type* compileExpression2(void);
-void compileExpression3(void);
-Type* compileTerm(void);
-void compileTerm2(void);
-Type* compileFactor(void);
-Type* compileIndexes(Type* arrayType);
+/* Outcome of compileBuffer: the diagnostics that compile() would have
+ * printed, or without any the symbol table dump it would have printed.
+ * The tree is kept when one is built and the whole program was parsed,
+ * errors or not, together with the atom table its names are in and its
+ * dump, which is made while the input is open to place its nodes. */
+typedef struct {
+  int diagnosticCount;
+  Diagnostic *diagnostics;
+  char *symtabDump;
+  size_t symtabDumpLength;
+  Ast *ast;
+  char *astDump;
+  size_t astDumpLength;
+  AtomTable *atoms;
+} CompileResult;
 
+/* Whether whole-buffer inputs are lexed into a TokenStream before
+ * parsing starts (the default) or scanned token by token */
+void setPretokenize(int on);
+
+/* Keeps the pre-tokenized streams of the inputs in directory and reuses
+ * them for inputs with the same bytes; NULL turns the cache off */
+void setTokenCache(const char *directory);
+
+/* How many errors are reported per input, 1 by default. With more, the
+ * parser goes on after an error from the end of the statement or
+ * declaration it was found in, and objects of the error type stand in
+ * for undeclared ones, so that one error is not reported again and
+ * again by the checks after it. An error found twice in a row at the
+ * same place is reported, and counted, once. */
+void setMaxErrors(int count);
+
+/* Whether the parser builds the tree of the program, off by default */
+void setBuildAst(int on);
+
+/* How many threads lex an input up front, for the compilations of the
+ * calling thread: 0, the default, for one per processor. Returns the
+ * count set before. */
+int setLexThreads(int threads);
+
+/* Starts a context on scanner, which the compilations run in it read */
+void initCompileContext(CompileContext *context, Scanner *scanner);
+void resetTokenRing(CompileContext *context);
+void startTokens(CompileContext *context);
+/* The k-th token after currentToken, k = 0 being lookAhead; k must be
+ * less than TOKEN_RING_SIZE - 1 */
+Token *peekToken(CompileContext *context, int k);
+void scan(CompileContext *context);
+void eat(CompileContext *context, TokenType tokenType);
+
+void compileProgram(CompileContext *context);
+void compileBlock(CompileContext *context);
+void compileBlock2(CompileContext *context);
+void compileBlock3(CompileContext *context);
+void compileBlock4(CompileContext *context);
+void compileBlock5(CompileContext *context);
+void compileConstDecls(CompileContext *context);
+void compileConstDecl(CompileContext *context);
+void compileTypeDecls(CompileContext *context);
+void compileTypeDecl(CompileContext *context);
+void compileVarDecls(CompileContext *context);
+void compileVarDecl(CompileContext *context);
+void compileSubDecls(CompileContext *context);
+void compileFuncDecl(CompileContext *context);
+void compileFuncHeading(CompileContext *context);
+void compileProcDecl(CompileContext *context);
+void compileProcHeading(CompileContext *context);
+ConstantValue* compileUnsignedConstant(CompileContext *context);
+ConstantValue* compileConstant(CompileContext *context);
+ConstantValue* compileConstant2(CompileContext *context);
+Type* compileType(CompileContext *context);
+Type* compileBasicType(CompileContext *context);
+void compileParams(CompileContext *context);
+void compileParam(CompileContext *context);
+void compileStatements(CompileContext *context);
+void compileStatement(CompileContext *context);
+Type* compileLValue(CompileContext *context);
+void compileAssignSt(CompileContext *context);
+void compileCallSt(CompileContext *context);
+void compileGroupSt(CompileContext *context);
+void compileIfSt(CompileContext *context);
+void compileElseSt(CompileContext *context);
+void compileWhileSt(CompileContext *context);
+void compileForSt(CompileContext *context);
+void compileArgument(CompileContext *context, Object* param);
+void compileArguments(CompileContext *context, ObjectNode* paramList);
+void compileAnyArguments(CompileContext *context);
+void compileCondition(CompileContext *context);
+Type* compileExpression(CompileContext *context);
+Type* compileExpression2(CompileContext *context);
+Type* compileFactor(CompileContext *context);
+Type* compileIndexes(CompileContext *context, Type* arrayType);
+
+/* Returns IO_SUCCESS, or the status of an input that could not be opened */
 int compile(char *fileName);
+/* Returns NULL if the buffer is longer than MAX_SOURCE_SIZE */
+CompileResult* compileBuffer(const char *buffer, size_t size);
+void printCompileResult(CompileResult *result);
+void freeCompileResult(CompileResult *result);
 
 #endif
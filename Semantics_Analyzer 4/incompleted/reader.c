@@ -4,34 +4,550 @@
  * @version 1.0
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "reader.h"
 
-FILE *inputStream;
-int lineNo, colNo;
-int currentChar;
+#define READ_CHUNK_SIZE 65536
+#define STREAM_CHUNK_SIZE (1 << 20)
+#define STREAM_CHUNKS 3
 
-int readChar(void) {
-  currentChar = getc(inputStream);
-  colNo ++;
-  if (currentChar == '\n') {
-    lineNo ++;
-    colNo = 0;
+/* Streamed input lives in three fixed chunks: the one under the cursor,
+ * the one before it (still needed to place tokens that started there)
+ * and the next one, which a reader thread fills while the scanner works
+ * on the current one. Memory stays the same whatever the input size. */
+typedef struct InputStream {
+  int fd;
+  char *chunks[STREAM_CHUNKS];
+  size_t lengths[STREAM_CHUNKS];
+  SourceOffset origins[STREAM_CHUNKS];
+  int previous, current, next;   /* chunk indexes, previous is -1 at first */
+
+  int threaded;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  int fillRequested;             /* next should be filled */
+  int nextReady;                 /* next has been filled */
+  int atEnd;                     /* read() hit end of input or failed */
+  int stopping;
+
+  /* where the retained chunks start, in lines */
+  int linesBefore;
+  SourceOffset lineStartBefore;
+
+  /* The starts of all the lines read so far, for inputs that keep them
+   * (see keepLineIndex); every chunk adds its own as it becomes current */
+  int keepLines;
+  SourceOffset *lineStarts;
+  int lineCount;
+  int lineCapacity;
+} InputStream;
+
+int refillStream(Scanner *scanner);
+
+int readChar(Scanner *scanner) {
+  if (scanner->input.cursor < scanner->input.limit)
+    scanner->currentChar = (unsigned char) *scanner->input.cursor++;
+  else if ((scanner->input.kind == INPUT_STREAM) && refillStream(scanner))
+    scanner->currentChar = (unsigned char) *scanner->input.cursor++;
+  else scanner->currentChar = EOF;
+  return scanner->currentChar;
+}
+
+int seekChar(Scanner *scanner, const char *p) {
+  scanner->input.cursor = p;
+  return readChar(scanner);
+}
+
+/******************************************************************/
+
+int countNewlines(const char *p, const char *limit) {
+  int count = 0;
+#ifdef __SSE2__
+  const __m128i newline = _mm_set1_epi8('\n');
+
+  for (; p + 16 <= limit; p += 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i*) p);
+    count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
   }
-  return currentChar;
+#endif
+  for (; p < limit; p ++)
+    if (*p == '\n') count ++;
+  return count;
 }
 
-int openInputStream(char *fileName) {
-  inputStream = fopen(fileName, "rt");
-  if (inputStream == NULL)
+void buildLineIndex(Scanner *scanner) {
+  const char *p = scanner->input.base;
+  const char *limit = scanner->input.limit;
+  SourceOffset *next;
+
+  scanner->lineCount = countNewlines(p, limit) + 1;
+  scanner->lineStarts = (SourceOffset*) malloc(scanner->lineCount * sizeof(SourceOffset));
+  next = scanner->lineStarts;
+  *next++ = 0;
+
+#ifdef __SSE2__
+  {
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    for (; p + 16 <= limit; p += 16) {
+      __m128i chunk = _mm_loadu_si128((const __m128i*) p);
+      unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+      while (mask != 0) {
+        *next++ = (SourceOffset) (p - scanner->input.base) + __builtin_ctz(mask) + 1;
+        mask &= mask - 1;
+      }
+    }
+  }
+#endif
+  for (; p < limit; p ++)
+    if (*p == '\n') *next++ = (SourceOffset) (p - scanner->input.base) + 1;
+}
+
+void freeLineIndex(Scanner *scanner) {
+  free(scanner->lineStarts);
+  scanner->lineStarts = NULL;
+  scanner->lineCount = 0;
+}
+
+void locateInStream(InputStream *stream, SourceOffset offset, int *lineNo, int *colNo);
+
+void locateOffset(Scanner *scanner, SourceOffset offset, int *lineNo, int *colNo) {
+  int low = 0, high;
+
+  if (scanner->input.kind == INPUT_STREAM) {
+    locateInStream(scanner->stream, offset, lineNo, colNo);
+    return;
+  }
+
+  if (scanner->lineStarts == NULL)
+    buildLineIndex(scanner);
+
+  // the last line starting at or before offset
+  high = scanner->lineCount - 1;
+  while (low < high) {
+    int mid = (low + high + 1) / 2;
+    if (scanner->lineStarts[mid] <= offset) low = mid;
+    else high = mid - 1;
+  }
+
+  if ((offset < scanner->input.size) && (scanner->input.base[offset] == '\n')) {
+    // a newline counts as column 0 of the line it opens
+    *lineNo = low + 2;
+    *colNo = 0;
+  } else {
+    *lineNo = low + 1;
+    *colNo = offset - scanner->lineStarts[low] + 1;
+  }
+}
+
+/******************************************************************/
+
+/* Reads until the chunk is full or the input ends, so that the scanner
+ * only ever sees large chunks whatever size the individual reads are. */
+size_t fillChunk(InputStream *stream, int index) {
+  char *chunk = stream->chunks[index];
+  size_t length = 0;
+  ssize_t n;
+
+  while (!stream->atEnd && (length < STREAM_CHUNK_SIZE)) {
+    n = read(stream->fd, chunk + length, STREAM_CHUNK_SIZE - length);
+    if (n > 0) length += n;
+    else stream->atEnd = 1;
+  }
+  return length;
+}
+
+void *prefetchStream(void *arg) {
+  InputStream *stream = (InputStream*) arg;
+
+  pthread_mutex_lock(&stream->lock);
+  while (!stream->stopping) {
+    if (stream->fillRequested) {
+      int index = stream->next;
+      size_t length;
+
+      pthread_mutex_unlock(&stream->lock);
+      length = fillChunk(stream, index);
+      pthread_mutex_lock(&stream->lock);
+
+      stream->lengths[index] = length;
+      stream->fillRequested = 0;
+      stream->nextReady = 1;
+      pthread_cond_broadcast(&stream->changed);
+    } else pthread_cond_wait(&stream->changed, &stream->lock);
+  }
+  pthread_mutex_unlock(&stream->lock);
+  return NULL;
+}
+
+void requestFill(InputStream *stream) {
+  stream->origins[stream->next] = stream->origins[stream->current] + (SourceOffset) stream->lengths[stream->current];
+  if (!stream->threaded) {
+    stream->lengths[stream->next] = fillChunk(stream, stream->next);
+    stream->nextReady = 1;
+    return;
+  }
+  pthread_mutex_lock(&stream->lock);
+  stream->nextReady = 0;
+  stream->fillRequested = 1;
+  pthread_cond_broadcast(&stream->changed);
+  pthread_mutex_unlock(&stream->lock);
+}
+
+void indexChunkLines(InputStream *stream, int index) {
+  const char *chunk = stream->chunks[index];
+  const char *p = chunk, *limit = chunk + stream->lengths[index];
+
+  while ((p = (const char*) memchr(p, '\n', limit - p)) != NULL) {
+    if (stream->lineCount == stream->lineCapacity) {
+      stream->lineCapacity *= 2;
+      stream->lineStarts = (SourceOffset*) realloc(stream->lineStarts, stream->lineCapacity * sizeof(SourceOffset));
+    }
+    p ++;
+    stream->lineStarts[stream->lineCount ++] = stream->origins[index] + (SourceOffset) (p - chunk);
+  }
+}
+
+/* The oldest chunk is about to be overwritten: remember how many lines
+ * it held and where its last line started. */
+void retireChunk(InputStream *stream, int index) {
+  const char *chunk = stream->chunks[index];
+  const char *lastNewline = memrchr(chunk, '\n', stream->lengths[index]);
+
+  stream->linesBefore += countNewlines(chunk, chunk + stream->lengths[index]);
+  if (lastNewline != NULL)
+    stream->lineStartBefore = stream->origins[index] + (SourceOffset) (lastNewline - chunk) + 1;
+}
+
+/* Called when the cursor has reached the end of the current chunk;
+ * returns 0 at the end of the input. */
+int refillStream(Scanner *scanner) {
+  InputStream *stream = scanner->stream;
+  int spare;
+
+  if (stream->threaded) {
+    pthread_mutex_lock(&stream->lock);
+    while (!stream->nextReady)
+      pthread_cond_wait(&stream->changed, &stream->lock);
+    pthread_mutex_unlock(&stream->lock);
+  }
+  if (stream->lengths[stream->next] == 0)
+    return 0;
+
+  if (stream->previous >= 0) {
+    retireChunk(stream, stream->previous);
+    spare = stream->previous;
+  } else spare = 3 - stream->current - stream->next;
+
+  stream->previous = stream->current;
+  stream->current = stream->next;
+  stream->next = spare;
+  if (stream->keepLines)
+    indexChunkLines(stream, stream->current);
+
+  scanner->input.base = scanner->input.cursor = stream->chunks[stream->current];
+  scanner->input.limit = scanner->input.base + stream->lengths[stream->current];
+  scanner->input.size = stream->lengths[stream->current];
+  scanner->input.origin = stream->origins[stream->current];
+
+  requestFill(stream);
+  return 1;
+}
+
+int openStream(Scanner *scanner, int fd) {
+  InputStream *stream = (InputStream*) calloc(1, sizeof(InputStream));
+  int i;
+
+  if (stream == NULL)
     return IO_ERROR;
-  lineNo = 1;
-  colNo = 0;
-  readChar();
+  stream->fd = fd;
+  for (i = 0; i < STREAM_CHUNKS; i ++) {
+    stream->chunks[i] = (char*) malloc(STREAM_CHUNK_SIZE);
+    if (stream->chunks[i] == NULL) {
+      while (i > 0) free(stream->chunks[--i]);
+      free(stream);
+      return IO_ERROR;
+    }
+  }
+  scanner->stream = stream;
+
+  stream->previous = -1;
+  stream->current = 0;
+  stream->next = 1;
+  stream->lengths[0] = fillChunk(stream, 0);
+  stream->origins[0] = 0;
+
+  scanner->input.base = scanner->input.cursor = stream->chunks[0];
+  scanner->input.limit = scanner->input.base + stream->lengths[0];
+  scanner->input.size = stream->lengths[0];
+  scanner->input.origin = 0;
+  scanner->input.kind = INPUT_STREAM;
+
+  pthread_mutex_init(&stream->lock, NULL);
+  pthread_cond_init(&stream->changed, NULL);
+  stream->threaded = !stream->atEnd && (pthread_create(&stream->thread, NULL, prefetchStream, stream) == 0);
+  if (!stream->atEnd)
+    requestFill(stream);
+  else stream->nextReady = 1;
+  return IO_SUCCESS;
+}
+
+void closeStream(InputStream *stream) {
+  int i;
+
+  if (stream->threaded) {
+    pthread_mutex_lock(&stream->lock);
+    stream->stopping = 1;
+    pthread_cond_broadcast(&stream->changed);
+    pthread_mutex_unlock(&stream->lock);
+    pthread_join(stream->thread, NULL);
+  }
+  pthread_mutex_destroy(&stream->lock);
+  pthread_cond_destroy(&stream->changed);
+
+  for (i = 0; i < STREAM_CHUNKS; i ++)
+    free(stream->chunks[i]);
+  free(stream->lineStarts);
+  if (stream->fd != STDIN_FILENO)
+    close(stream->fd);
+  free(stream);
+}
+
+/* Without a line index, only the retained chunks are available, so
+ * positions are worked out by counting from where they start. Anything
+ * older than that can no longer be placed and is reported at the first
+ * retained line. */
+void keepLineIndex(Scanner *scanner) {
+  InputStream *stream = scanner->stream;
+
+  if ((scanner->input.kind != INPUT_STREAM) || stream->keepLines)
+    return;
+  stream->keepLines = 1;
+  stream->lineCapacity = 1024;
+  stream->lineStarts = (SourceOffset*) malloc(stream->lineCapacity * sizeof(SourceOffset));
+  stream->lineStarts[0] = 0;
+  stream->lineCount = 1;
+  if (stream->previous >= 0)
+    indexChunkLines(stream, stream->previous);
+  indexChunkLines(stream, stream->current);
+}
+
+void locateInStream(InputStream *stream, SourceOffset offset, int *lineNo, int *colNo) {
+  int order[2], i, count = 0;
+  int line = stream->linesBefore;
+  SourceOffset lineStart = stream->lineStartBefore;
+  SourceOffset windowOrigin, windowSize = 0, rest;
+  int low = 0, high;
+
+  if (stream->keepLines) {
+    // the last line starting at or before offset
+    high = stream->lineCount - 1;
+    while (low < high) {
+      int mid = (low + high + 1) / 2;
+      if (stream->lineStarts[mid] <= offset) low = mid;
+      else high = mid - 1;
+    }
+    if ((low + 1 < stream->lineCount) && (stream->lineStarts[low + 1] == offset + 1)) {
+      // a newline counts as column 0 of the line it opens
+      *lineNo = low + 2;
+      *colNo = 0;
+    } else {
+      *lineNo = low + 1;
+      *colNo = offset - stream->lineStarts[low] + 1;
+    }
+    return;
+  }
+
+  if (stream->previous >= 0) order[count++] = stream->previous;
+  order[count++] = stream->current;
+
+  windowOrigin = stream->origins[order[0]];
+  for (i = 0; i < count; i ++)
+    windowSize += (SourceOffset) stream->lengths[order[i]];
+
+  rest = offset - windowOrigin;
+  if (rest > windowSize) {
+    *lineNo = line + 1;
+    *colNo = 0;
+    return;
+  }
+
+  for (i = 0; i < count; i ++) {
+    const char *chunk = stream->chunks[order[i]];
+    size_t n = (rest < stream->lengths[order[i]]) ? rest : stream->lengths[order[i]];
+    const char *lastNewline = memrchr(chunk, '\n', n);
+
+    line += countNewlines(chunk, chunk + n);
+    if (lastNewline != NULL)
+      lineStart = stream->origins[order[i]] + (SourceOffset) (lastNewline - chunk) + 1;
+
+    if (rest < stream->lengths[order[i]]) {
+      if (chunk[rest] == '\n') {
+        // a newline counts as column 0 of the line it opens
+        *lineNo = line + 2;
+        *colNo = 0;
+        return;
+      }
+      break;
+    }
+    rest -= n;
+  }
+
+  *lineNo = line + 1;
+  *colNo = offset - lineStart + 1;
+}
+
+/******************************************************************/
+
+/* Fallback for inputs that cannot be mapped: slurp them into the heap */
+int readWholeFile(Scanner *scanner, int fd) {
+  char *data = NULL;
+  size_t size = 0, capacity = 0;
+  ssize_t n;
+
+  do {
+    if (size == capacity) {
+      char *grown;
+      capacity = (capacity == 0) ? READ_CHUNK_SIZE : capacity * 2;
+      grown = (char*) realloc(data, capacity);
+      if (grown == NULL) {
+        free(data);
+        return IO_ERROR;
+      }
+      data = grown;
+    }
+    n = read(fd, data + size, capacity - size);
+    if (n > 0) size += n;
+  } while (n > 0);
+
+  if (n < 0) {
+    free(data);
+    return IO_ERROR;
+  }
+
+  scanner->input.base = data;
+  scanner->input.size = size;
+  scanner->input.kind = INPUT_HEAP;
+  return IO_SUCCESS;
+}
+
+void initScanner(Scanner *scanner) {
+  memset(scanner, 0, sizeof(Scanner));
+  scanner->currentChar = EOF;
+  scanner->input.kind = INPUT_BORROWED;
+}
+
+int openInputBuffer(Scanner *scanner, char *fileName) {
+  struct stat st;
+  void *data;
+  int fd;
+  int result = IO_SUCCESS;
+
+  initScanner(scanner);
+
+  if (strcmp(fileName, "-") == 0)
+    fd = STDIN_FILENO;
+  else fd = open(fileName, O_RDONLY);
+  if (fd < 0)
+    return IO_ERROR;
+
+  if ((fstat(fd, &st) != 0) || !S_ISREG(st.st_mode)) {
+    if (openStream(scanner, fd) == IO_ERROR) {
+      if (fd != STDIN_FILENO) close(fd);
+      return IO_ERROR;
+    }
+    return IO_SUCCESS;
+  }
+  if ((unsigned long long) st.st_size > MAX_SOURCE_SIZE) {
+    if (fd != STDIN_FILENO) close(fd);
+    return IO_TOO_LARGE;
+  }
+
+  if (st.st_size > 0) {
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      madvise(data, st.st_size, MADV_SEQUENTIAL);
+      scanner->input.base = (const char*) data;
+      scanner->input.size = st.st_size;
+      scanner->input.kind = INPUT_MAPPED;
+    } else result = readWholeFile(scanner, fd);
+  } else result = readWholeFile(scanner, fd);
+
+  close(fd);
+  if (result == IO_ERROR)
+    return IO_ERROR;
+
+  scanner->input.cursor = scanner->input.base;
+  scanner->input.limit = scanner->input.base + scanner->input.size;
+  scanner->input.origin = 0;
+  return IO_SUCCESS;
+}
+
+void useInputBuffer(Scanner *scanner, const char *buffer, size_t size) {
+  initScanner(scanner);
+  scanner->input.base = scanner->input.cursor = buffer;
+  scanner->input.limit = buffer + size;
+  scanner->input.size = size;
+  scanner->input.origin = 0;
+  scanner->input.kind = INPUT_BORROWED;
+}
+
+void closeInputBuffer(Scanner *scanner) {
+  switch (scanner->input.kind) {
+  case INPUT_MAPPED:
+    munmap((void*) scanner->input.base, scanner->input.size);
+    break;
+  case INPUT_HEAP:
+    free((void*) scanner->input.base);
+    break;
+  case INPUT_STREAM:
+    closeStream(scanner->stream);
+    scanner->stream = NULL;
+    break;
+  case INPUT_BORROWED:
+    break;
+  }
+  scanner->input.base = scanner->input.cursor = scanner->input.limit = NULL;
+  scanner->input.size = 0;
+  scanner->input.origin = 0;
+  scanner->input.kind = INPUT_BORROWED;
+}
+
+/* "-" names the standard input. Anything that is not a regular file is
+ * streamed rather than read up front. */
+int openInputStream(Scanner *scanner, char *fileName) {
+  int status = openInputBuffer(scanner, fileName);
+
+  if (status != IO_SUCCESS)
+    return status;
+  readChar(scanner);
+  return IO_SUCCESS;
+}
+
+int openInputMemory(Scanner *scanner, const char *buffer, size_t size) {
+  if (size > MAX_SOURCE_SIZE) {
+    initScanner(scanner);
+    return IO_TOO_LARGE;
+  }
+  useInputBuffer(scanner, buffer, size);
+  readChar(scanner);
   return IO_SUCCESS;
 }
 
-void closeInputStream() {
-  fclose(inputStream);
+void closeInputStream(Scanner *scanner) {
+  freeLineIndex(scanner);
+  closeInputBuffer(scanner);
 }
 
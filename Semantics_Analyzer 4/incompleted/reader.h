@@ -7,11 +7,91 @@
 #ifndef __READER_H__
 #define __READER_H__
 
+#include <stdio.h>
+#include <stddef.h>
+#include <limits.h>
+
 #define IO_ERROR 0
 #define IO_SUCCESS 1
+#define IO_TOO_LARGE 2    /* a file or buffer longer than MAX_SOURCE_SIZE */
+
+/* Byte offset into the source text. Tokens and diagnostics carry only
+ * this; line and column are worked out when a message is printed.
+ * Streamed inputs may exceed 4GB, so offsets there wrap around and are
+ * only compared relative to the bytes still held by the reader. Whole
+ * inputs, mapped, read or in memory, are held all at once and indexed
+ * by offset, so they are refused past what an offset can address. */
+typedef unsigned int SourceOffset;
+
+#define MAX_SOURCE_SIZE ((size_t) UINT_MAX)
+
+enum InputKind {
+  INPUT_HEAP,       /* read into a buffer owned by the reader */
+  INPUT_MAPPED,     /* mapped from the input file */
+  INPUT_BORROWED,   /* supplied and owned by the caller */
+  INPUT_STREAM      /* pipe or terminal, read chunk by chunk */
+};
+
+/* The source text under the cursor. For files this is the whole text,
+ * mapped or, if mapping fails, read into the heap. For streams (stdin,
+ * pipes) it is the current chunk only, and readChar() moves on to the
+ * next chunk when the cursor reaches limit.
+ * The scanner may walk [cursor, limit) directly instead of calling
+ * readChar() for every byte. */
+typedef struct {
+  const char *base;     /* first byte of the text or chunk */
+  const char *cursor;   /* next byte to be read */
+  const char *limit;    /* one past the last byte */
+  size_t size;
+  SourceOffset origin;  /* offset of base within the source text */
+  enum InputKind kind;
+} InputBuffer;
+
+struct InputStream;
+
+/* Everything the reader and scanner know about one input. Each
+ * compilation owns its Scanner, so any number of them can run at once,
+ * one per thread. */
+typedef struct {
+  InputBuffer input;
+  int currentChar;
+
+  /* Offsets of the first byte of every line, built the first time an
+   * offset has to be turned into a line and column */
+  SourceOffset *lineStarts;
+  int lineCount;
+
+  struct InputStream *stream;   /* chunk state of an INPUT_STREAM input */
+} Scanner;
+
+/* Puts a scanner in the closed state; the open functions do this too */
+void initScanner(Scanner *scanner);
+
+int readChar(Scanner *scanner);
+int openInputStream(Scanner *scanner, char *fileName);
+int openInputMemory(Scanner *scanner, const char *buffer, size_t size);
+void closeInputStream(Scanner *scanner);
+
+int openInputBuffer(Scanner *scanner, char *fileName);
+void useInputBuffer(Scanner *scanner, const char *buffer, size_t size);
+void closeInputBuffer(Scanner *scanner);
+
+/* Moves the cursor to p, a position inside the current buffer that the
+ * scanner has reached on its own, and reloads currentChar from there. */
+int seekChar(Scanner *scanner, const char *p);
+
+/* Offset of currentChar; at end of input this is the size of the text */
+static inline SourceOffset currentOffset(Scanner *scanner) {
+  if (scanner->currentChar == EOF)
+    return scanner->input.origin + (SourceOffset) (scanner->input.limit - scanner->input.base);
+  return scanner->input.origin + (SourceOffset) (scanner->input.cursor - scanner->input.base - 1);
+}
 
-int readChar(void);
-int openInputStream(char *fileName);
-void closeInputStream(void);
+void locateOffset(Scanner *scanner, SourceOffset offset, int *lineNo, int *colNo);
+/* Has a streamed input keep the starts of its lines from here on, so
+ * that locateOffset can place any offset read since, and quickly; it
+ * costs memory in proportion to the lines. Inputs held whole always
+ * can be located. Call it before the scanner leaves the first chunk. */
+void keepLineIndex(Scanner *scanner);
 
 #endif
@@ -6,249 +6,222 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <ctype.h>
+#include <string.h>
+#include <limits.h>
 
 #include "reader.h"
 #include "charcode.h"
 #include "token.h"
 #include "error.h"
 #include "scanner.h"
+#include "charscan.h"
+#include "lexer.h"
 
 
-extern int lineNo;
-extern int colNo;
-extern int currentChar;
-
-extern CharCode charCodes[];
+extern const CharCode charCodes[];
 
 /***************************************************************/
 
-void skipBlank() {
-  while ((currentChar != EOF) && (charCodes[currentChar] == CHAR_SPACE))
-    readChar();
+Token* setToken(Token *token, TokenType tokenType, SourceOffset offset) {
+  token->tokenType = tokenType;
+  token->offset = offset;
+  return token;
 }
 
-void skipComment() {
-  int state = 0;
-  while ((currentChar != EOF) && (state < 2)) {
-    switch (charCodes[currentChar]) {
-    case CHAR_TIMES:
-      state = 1;
-      break;
-    case CHAR_RPAR:
-      if (state == 1) state = 2;
-      else state = 0;
-      break;
-    default:
-      state = 0;
-    }
-    readChar();
-  }
-  if (state != 2) 
-    error(ERR_END_OF_COMMENT, lineNo, colNo);
+void skipBlank(Scanner *scanner) {
+  // the kernel walks the buffer directly; readChar() is only needed to
+  // cross into the next chunk of a streamed input
+  while ((scanner->currentChar != EOF) && (charCodes[scanner->currentChar] == CHAR_SPACE))
+    seekChar(scanner, skipSpaceRun(scanner->input.cursor, scanner->input.limit));
 }
 
-Token* readIdentKeyword(void) {
-  Token *token = makeToken(TK_NONE, lineNo, colNo);
-  int count = 1;
+void skipComment(Scanner *scanner) {
+  const char *end;
 
-  token->string[0] = toupper((char)currentChar);
-  readChar();
+  // currentChar sits at input.cursor - 1, so the search starts there
+  while (scanner->currentChar != EOF) {
+    end = findCommentEnd(scanner->input.cursor - 1, scanner->input.limit);
+    if (end != NULL) {
+      seekChar(scanner, end + 2);
+      return;
+    }
 
-  while ((currentChar != EOF) && 
-	 ((charCodes[currentChar] == CHAR_LETTER) || (charCodes[currentChar] == CHAR_DIGIT))) {
-    if (count <= MAX_IDENT_LEN) token->string[count++] = toupper((char)currentChar);
-    readChar();
+    // a '*' ending this chunk may be closed by a ')' starting the next one
+    if (scanner->input.limit[-1] == '*') {
+      seekChar(scanner, scanner->input.limit);
+      if (scanner->currentChar == ')') {
+        readChar(scanner);
+        return;
+      }
+    } else seekChar(scanner, scanner->input.limit);
   }
+  error(ERR_END_OF_COMMENT, currentOffset(scanner));
+}
 
-  if (count > MAX_IDENT_LEN) {
-    error(ERR_IDENT_TOO_LONG, token->lineNo, token->colNo);
-    return token;
+Token* readIdentKeyword(Scanner *scanner, Token *token) {
+  char word[2 * (MAX_IDENT_LEN + 1)];
+  char *name = word;
+  const char *start, *end;
+  size_t count = 0, capacity = sizeof(word), n, i;
+
+  setToken(token, TK_NONE, currentOffset(scanner));
+
+  // each pass takes the whole run left in the buffer; it only repeats
+  // when a streamed chunk ends inside the identifier. A name longer than
+  // word holds goes on the heap.
+  while ((scanner->currentChar != EOF) &&
+	 ((charCodes[scanner->currentChar] == CHAR_LETTER) || (charCodes[scanner->currentChar] == CHAR_DIGIT))) {
+    start = scanner->input.cursor - 1;
+    end = skipWordRun(start, scanner->input.limit);
+    n = end - start;
+    if (count + n <= MAX_IDENT_LEN + 1)
+      copyUpper(word + count, start, n, scanner->input.limit);
+    else {
+      if (count + n > capacity) {
+        capacity = 2 * (count + n);
+        if (name == word) {
+          name = (char*) malloc(capacity);
+          memcpy(name, word, count);
+        } else name = (char*) realloc(name, capacity);
+      }
+      for (i = 0; i < n; i++)
+        name[count + i] = ((start[i] >= 'a') && (start[i] <= 'z')) ? start[i] - 0x20 : start[i];
+    }
+    count += n;
+    seekChar(scanner, end);
   }
 
-  token->string[count] = '\0';
-  token->tokenType = checkKeyword(token->string);
+  if (count <= MAX_IDENT_LEN) {
+    // word is zero padded past count, which is what lookupKeyword expects
+    memcpy(token->string, word, MAX_IDENT_LEN + 1);
+    token->tokenType = lookupKeyword(token->string, count);
+  } else {
+    memcpy(token->string, name, MAX_IDENT_LEN);
+    token->string[MAX_IDENT_LEN] = '\0';
+  }
 
-  if (token->tokenType == TK_NONE)
+  if (token->tokenType == TK_NONE) {
     token->tokenType = TK_IDENT;
+    token->atom = internRun(name, count);
+  }
+  if (name != word)
+    free(name);
+  if ((token->tokenType == TK_IDENT) && (token->atom == NO_ATOM))
+    error(ERR_TOO_MANY_IDENTS, token->offset);
 
   return token;
 }
 
-Token* readNumber(void) {
-  Token *token = makeToken(TK_NUMBER, lineNo, colNo);
-  int count = 0;
-
-  while ((currentChar != EOF) && (charCodes[currentChar] == CHAR_DIGIT)) {
-    token->string[count++] = (char)currentChar;
-    readChar();
+Token* readNumber(Scanner *scanner, Token *token) {
+  const char *p, *end;
+  long value = 0;
+  int count = 0, digit;
+
+  setToken(token, TK_NUMBER, currentOffset(scanner));
+
+  while ((scanner->currentChar != EOF) && (charCodes[scanner->currentChar] == CHAR_DIGIT)) {
+    p = scanner->input.cursor - 1;
+    end = skipDigitRun(p, scanner->input.limit);
+    for (; p < end; p ++) {
+      digit = *p - '0';
+      // saturate like atoi did on overflow
+      if (value > (LONG_MAX - digit) / 10) value = LONG_MAX;
+      else value = value * 10 + digit;
+      if (count < MAX_IDENT_LEN) token->string[count++] = *p;
+    }
+    seekChar(scanner, end);
   }
 
   token->string[count] = '\0';
-  token->value = atoi(token->string);
+  token->value = (int) value;
   return token;
 }
 
-Token* readConstChar(void) {
-  Token *token = makeToken(TK_CHAR, lineNo, colNo);
+Token* readConstChar(Scanner *scanner, Token *token) {
+  setToken(token, TK_CHAR, currentOffset(scanner));
 
-  readChar();
-  if (currentChar == EOF) {
+  readChar(scanner);
+  if (scanner->currentChar == EOF) {
     token->tokenType = TK_NONE;
-    error(ERR_INVALID_CONSTANT_CHAR, token->lineNo, token->colNo);
+    error(ERR_INVALID_CONSTANT_CHAR, token->offset);
     return token;
   }
     
-  token->string[0] = currentChar;
+  token->string[0] = scanner->currentChar;
   token->string[1] = '\0';
 
-  readChar();
-  if (currentChar == EOF) {
+  readChar(scanner);
+  if (scanner->currentChar == EOF) {
     token->tokenType = TK_NONE;
-    error(ERR_INVALID_CONSTANT_CHAR, token->lineNo, token->colNo);
+    error(ERR_INVALID_CONSTANT_CHAR, token->offset);
     return token;
   }
 
-  if (charCodes[currentChar] == CHAR_SINGLEQUOTE) {
-    readChar();
+  if (charCodes[scanner->currentChar] == CHAR_SINGLEQUOTE) {
+    readChar(scanner);
     return token;
   } else {
     token->tokenType = TK_NONE;
-    error(ERR_INVALID_CONSTANT_CHAR, token->lineNo, token->colNo);
+    error(ERR_INVALID_CONSTANT_CHAR, token->offset);
     return token;
   }
 }
 
-Token* getToken(void) {
-  Token *token;
-  int ln, cn;
-
-  if (currentChar == EOF) 
-    return makeToken(TK_EOF, lineNo, colNo);
+/* Runs the DFA of lexer.def from the current character. Symbols are
+ * matched by the table alone; the other tokens, blanks and comments are
+ * handed to their readers once the DFA has seen how they start. */
+Token* readToken(Scanner *scanner, Token *token) {
+  SourceOffset pos;
+  int state, next;
+
+  for (;;) {
+    pos = currentOffset(scanner);
+    for (state = LEX_START; ; readChar(scanner)) {
+      next = (scanner->currentChar == EOF) ? LEX_STOP : lexNext[state][lexClass[scanner->currentChar]];
+      if ((next == LEX_STOP) || (next >= LEX_FIRST_ACTION)) break;
+      state = next;
+    }
 
-  switch (charCodes[currentChar]) {
-  case CHAR_SPACE: skipBlank(); return getToken();
-  case CHAR_LETTER: return readIdentKeyword();
-  case CHAR_DIGIT: return readNumber();
-  case CHAR_PLUS: 
-    token = makeToken(SB_PLUS, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_MINUS:
-    token = makeToken(SB_MINUS, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_TIMES:
-    token = makeToken(SB_TIMES, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_SLASH:
-    token = makeToken(SB_SLASH, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_LT:
-    ln = lineNo;
-    cn = colNo;
-    readChar();
-    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ)) {
-      readChar();
-      return makeToken(SB_LE, ln, cn);
-    } else return makeToken(SB_LT, ln, cn);
-  case CHAR_GT:
-    ln = lineNo;
-    cn = colNo;
-    readChar();
-    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ)) {
-      readChar();
-      return makeToken(SB_GE, ln, cn);
-    } else return makeToken(SB_GT, ln, cn);
-  case CHAR_EQ: 
-    token = makeToken(SB_EQ, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_EXCLAIMATION:
-    ln = lineNo;
-    cn = colNo;
-    readChar();
-    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ)) {
-      readChar();
-      return makeToken(SB_NEQ, ln, cn);
-    } else {
-      token = makeToken(TK_NONE, ln, cn);
-      error(ERR_INVALID_SYMBOL, ln, cn);
+    switch (next) {
+    case LEX_STOP:
+      setToken(token, lexAccept[state], pos);
+      if (token->tokenType == TK_NONE)
+        error(ERR_INVALID_SYMBOL, pos);
       return token;
+    case LEX_IDENT: return readIdentKeyword(scanner, token);
+    case LEX_NUMBER: return readNumber(scanner, token);
+    case LEX_CHAR: return readConstChar(scanner, token);
+    case LEX_BLANK: skipBlank(scanner); break;
+    case LEX_COMMENT:
+      readChar(scanner);
+      skipComment(scanner);
+      break;
     }
-  case CHAR_COMMA:
-    token = makeToken(SB_COMMA, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_PERIOD:
-    ln = lineNo;
-    cn = colNo;
-    readChar();
-    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_RPAR)) {
-      readChar();
-      return makeToken(SB_RSEL, ln, cn);
-    } else return makeToken(SB_PERIOD, ln, cn);
-  case CHAR_SEMICOLON:
-    token = makeToken(SB_SEMICOLON, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_COLON:
-    ln = lineNo;
-    cn = colNo;
-    readChar();
-    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ)) {
-      readChar();
-      return makeToken(SB_ASSIGN, ln, cn);
-    } else return makeToken(SB_COLON, ln, cn);
-  case CHAR_SINGLEQUOTE: return readConstChar();
-  case CHAR_LPAR:
-    ln = lineNo;
-    cn = colNo;
-    readChar();
-
-    if (currentChar == EOF) 
-      return makeToken(SB_LPAR, ln, cn);
-
-    switch (charCodes[currentChar]) {
-    case CHAR_PERIOD:
-      readChar();
-      return makeToken(SB_LSEL, ln, cn);
-    case CHAR_TIMES:
-      readChar();
-      skipComment();
-      return getToken();
-    default:
-      return makeToken(SB_LPAR, ln, cn);
-    }
-  case CHAR_RPAR:
-    token = makeToken(SB_RPAR, lineNo, colNo);
-    readChar(); 
-    return token;
-  default:
-    token = makeToken(TK_NONE, lineNo, colNo);
-    error(ERR_INVALID_SYMBOL, lineNo, colNo);
-    readChar(); 
-    return token;
   }
 }
 
-Token* getValidToken(void) {
-  Token *token = getToken();
-  while (token->tokenType == TK_NONE) {
-    free(token);
-    token = getToken();
-  }
+Token* readValidToken(Scanner *scanner, Token *token) {
+  do readToken(scanner, token);
+  while (token->tokenType == TK_NONE);
   return token;
 }
 
+Token* getToken(Scanner *scanner) {
+  return readToken(scanner, (Token*) malloc(sizeof(Token)));
+}
+
+Token* getValidToken(Scanner *scanner) {
+  return readValidToken(scanner, (Token*) malloc(sizeof(Token)));
+}
+
 
 /******************************************************************/
 
-void printToken(Token *token) {
+void printToken(Scanner *scanner, Token *token) {
+  int lineNo, colNo;
 
-  printf("%d-%d:", token->lineNo, token->colNo);
+  locateOffset(scanner, token->offset, &lineNo, &colNo);
+  printf("%d-%d:", lineNo, colNo);
 
   switch (token->tokenType) {
   case TK_NONE: printf("TK_NONE\n"); break;
@@ -9,8 +9,13 @@
 
 #include "token.h"
 
-Token* getToken(void);
-Token* getValidToken(void);
-void printToken(Token *token);
+/* Scan the next token into a token owned by the caller */
+Token* readToken(Scanner *scanner, Token *token);
+Token* readValidToken(Scanner *scanner, Token *token);
+
+/* Same, into a newly allocated token */
+Token* getToken(Scanner *scanner);
+Token* getValidToken(Scanner *scanner);
+void printToken(Scanner *scanner, Token *token);
 
 #endif
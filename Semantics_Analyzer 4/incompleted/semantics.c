@@ -9,11 +9,8 @@
 #include "semantics.h"
 #include "error.h"
 
-extern SymTab *symtab;
-extern Token *currentToken;
-
-Object *lookupObject(char *name) {
-    Scope *scope = symtab->currentScope;
+Object *lookupObject(CompileContext *context, Atom name) {
+    Scope *scope = context->symtab->currentScope;
     Object *obj;
 
     while (scope != NULL) {
@@ -21,120 +18,111 @@ Object *lookupObject(char *name) {
         if (obj != NULL) return obj;
         scope = scope->outer;
     }
-    obj = findObject(symtab->globalObjectList, name);
+    obj = findObject(context->symtab->globalObjectList, name);
     if (obj != NULL) return obj;
     return NULL;
 }
 
-void checkFreshIdent(char *name) {
-    if (findObject(symtab->currentScope->objList, name) != NULL)
-        error(ERR_DUPLICATE_IDENT, currentToken->lineNo, currentToken->colNo);
+void checkFreshIdent(CompileContext *context, Atom name) {
+    if (findObject(context->symtab->currentScope->objList, name) != NULL)
+        recoverableError(ERR_DUPLICATE_IDENT, context->currentToken->offset);
 }
 
-Object *checkDeclaredIdent(char *name) {
-    Object *obj = lookupObject(name);
+/* The checks below report an undeclared object, or one of the wrong
+ * kind, and when compiling goes on return an error object in its place */
+Object *checkDeclaredKind(CompileContext *context, Atom name, enum ObjectKind kind, ErrorCode undeclared, ErrorCode invalid) {
+    Object *obj = lookupObject(context, name);
+
     if (obj == NULL) {
-        error(ERR_UNDECLARED_IDENT, currentToken->lineNo, currentToken->colNo);
+        recoverableError(undeclared, context->currentToken->offset);
+        return createErrorObject(context->symtab, name, kind);
+    }
+    if (obj->kind != kind) {
+        recoverableError(invalid, context->currentToken->offset);
+        return createErrorObject(context->symtab, name, kind);
     }
     return obj;
 }
 
-Object *checkDeclaredConstant(char *name) {
-    Object *obj = lookupObject(name);
-    if (obj == NULL)
-        error(ERR_UNDECLARED_CONSTANT, currentToken->lineNo, currentToken->colNo);
-    if (obj->kind != OBJ_CONSTANT)
-        error(ERR_INVALID_CONSTANT, currentToken->lineNo, currentToken->colNo);
-
+Object *checkDeclaredIdent(CompileContext *context, Atom name) {
+    Object *obj = lookupObject(context, name);
+    if (obj == NULL) {
+        recoverableError(ERR_UNDECLARED_IDENT, context->currentToken->offset);
+        obj = createErrorObject(context->symtab, name, OBJ_VARIABLE);
+    }
     return obj;
 }
 
-Object *checkDeclaredType(char *name) {
-    Object *obj = lookupObject(name);
-    if (obj == NULL)
-        error(ERR_UNDECLARED_TYPE, currentToken->lineNo, currentToken->colNo);
-    if (obj->kind != OBJ_TYPE)
-        error(ERR_INVALID_TYPE, currentToken->lineNo, currentToken->colNo);
-
-    return obj;
+Object *checkDeclaredConstant(CompileContext *context, Atom name) {
+    return checkDeclaredKind(context, name, OBJ_CONSTANT, ERR_UNDECLARED_CONSTANT, ERR_INVALID_CONSTANT);
 }
 
-Object *checkDeclaredVariable(char *name) {
-    Object *obj = lookupObject(name);
-    if (obj == NULL)
-        error(ERR_UNDECLARED_VARIABLE, currentToken->lineNo, currentToken->colNo);
-    if (obj->kind != OBJ_VARIABLE)
-        error(ERR_INVALID_VARIABLE, currentToken->lineNo, currentToken->colNo);
-
-    return obj;
+Object *checkDeclaredType(CompileContext *context, Atom name) {
+    return checkDeclaredKind(context, name, OBJ_TYPE, ERR_UNDECLARED_TYPE, ERR_INVALID_TYPE);
 }
 
-Object *checkDeclaredFunction(char *name) {
-    Object *obj = lookupObject(name);
-    if (obj == NULL)
-        error(ERR_UNDECLARED_FUNCTION, currentToken->lineNo, currentToken->colNo);
-    if (obj->kind != OBJ_FUNCTION)
-        error(ERR_INVALID_FUNCTION, currentToken->lineNo, currentToken->colNo);
-
-    return obj;
+Object *checkDeclaredVariable(CompileContext *context, Atom name) {
+    return checkDeclaredKind(context, name, OBJ_VARIABLE, ERR_UNDECLARED_VARIABLE, ERR_INVALID_VARIABLE);
 }
 
-Object *checkDeclaredProcedure(char *name) {
-    Object *obj = lookupObject(name);
-    if (obj == NULL)
-        error(ERR_UNDECLARED_PROCEDURE, currentToken->lineNo, currentToken->colNo);
-    if (obj->kind != OBJ_PROCEDURE)
-        error(ERR_INVALID_PROCEDURE, currentToken->lineNo, currentToken->colNo);
+Object *checkDeclaredFunction(CompileContext *context, Atom name) {
+    return checkDeclaredKind(context, name, OBJ_FUNCTION, ERR_UNDECLARED_FUNCTION, ERR_INVALID_FUNCTION);
+}
 
-    return obj;
+Object *checkDeclaredProcedure(CompileContext *context, Atom name) {
+    return checkDeclaredKind(context, name, OBJ_PROCEDURE, ERR_UNDECLARED_PROCEDURE, ERR_INVALID_PROCEDURE);
 }
 
-Object *checkDeclaredLValueIdent(char *name) {
-    Object *obj = lookupObject(name);
-    if (obj == NULL)
-        error(ERR_UNDECLARED_IDENT, currentToken->lineNo, currentToken->colNo);
+Object *checkDeclaredLValueIdent(CompileContext *context, Atom name) {
+    Object *obj = lookupObject(context, name);
+    if (obj == NULL) {
+        recoverableError(ERR_UNDECLARED_IDENT, context->currentToken->offset);
+        return createErrorObject(context->symtab, name, OBJ_VARIABLE);
+    }
 
     switch (obj->kind) {
         case OBJ_VARIABLE:
         case OBJ_PARAMETER:
             break;
         case OBJ_FUNCTION:
-            if (obj != symtab->currentScope->owner)
-                error(ERR_INVALID_IDENT, currentToken->lineNo, currentToken->colNo);
+            if (obj != context->symtab->currentScope->owner) {
+                recoverableError(ERR_INVALID_IDENT, context->currentToken->offset);
+                return createErrorObject(context->symtab, name, OBJ_VARIABLE);
+            }
             break;
         default:
-            error(ERR_INVALID_IDENT, currentToken->lineNo, currentToken->colNo);
+            recoverableError(ERR_INVALID_IDENT, context->currentToken->offset);
+            return createErrorObject(context->symtab, name, OBJ_VARIABLE);
     }
 
     return obj;
 }
 
 
-void checkIntType(Type *type) {
-    if (type != NULL && type->typeClass != TP_INT)
-        error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
+void checkIntType(CompileContext *context, Type *type) {
+    if (type != NULL && type->typeClass != TP_INT && type->typeClass != TP_ERROR)
+        recoverableError(ERR_TYPE_INCONSISTENCY, context->currentToken->offset);
 }
 
-void checkCharType(Type *type) {
+void checkCharType(CompileContext *context, Type *type) {
 
-    if (type != NULL && type->typeClass != TP_CHAR)
-        error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
+    if (type != NULL && type->typeClass != TP_CHAR && type->typeClass != TP_ERROR)
+        recoverableError(ERR_TYPE_INCONSISTENCY, context->currentToken->offset);
 }
 
-void checkBasicType(Type *type) {
+void checkBasicType(CompileContext *context, Type *type) {
 
     if (type != NULL && type->typeClass != TP_ARRAY) return;
-    error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
+    recoverableError(ERR_TYPE_INCONSISTENCY, context->currentToken->offset);
 }
 
-void checkArrayType(Type *type) {
+void checkArrayType(CompileContext *context, Type *type) {
 
-    if (type != NULL && type->typeClass != TP_ARRAY)
-        error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
+    if (type != NULL && type->typeClass != TP_ARRAY && type->typeClass != TP_ERROR)
+        recoverableError(ERR_TYPE_INCONSISTENCY, context->currentToken->offset);
 }
 
-void checkTypeEquality(Type *type1, Type *type2) {
+void checkTypeEquality(CompileContext *context, Type *type1, Type *type2) {
 
-    if (!compareType(type1, type2)) error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
+    if (!compareType(type1, type2)) recoverableError(ERR_TYPE_INCONSISTENCY, context->currentToken->offset);
 }
-
@@ -8,20 +8,21 @@
 #define __SEMANTICS_H__
 
 #include "symtab.h"
+#include "context.h"
 
-void checkFreshIdent(char *name);
-Object* checkDeclaredIdent(char *name);
-Object* checkDeclaredConstant(char *name);
-Object* checkDeclaredType(char *name);
-Object* checkDeclaredVariable(char *name);
-Object* checkDeclaredFunction(char *name);
-Object* checkDeclaredProcedure(char *name);
-Object* checkDeclaredLValueIdent(char *name);
+void checkFreshIdent(CompileContext *context, Atom name);
+Object* checkDeclaredIdent(CompileContext *context, Atom name);
+Object* checkDeclaredConstant(CompileContext *context, Atom name);
+Object* checkDeclaredType(CompileContext *context, Atom name);
+Object* checkDeclaredVariable(CompileContext *context, Atom name);
+Object* checkDeclaredFunction(CompileContext *context, Atom name);
+Object* checkDeclaredProcedure(CompileContext *context, Atom name);
+Object* checkDeclaredLValueIdent(CompileContext *context, Atom name);
 
-void checkIntType(Type* type);
-void checkCharType(Type* type);
-void checkArrayType(Type* type);
-void checkBasicType(Type* type);
-void checkTypeEquality(Type* type1, Type* type2);
+void checkIntType(CompileContext *context, Type* type);
+void checkCharType(CompileContext *context, Type* type);
+void checkArrayType(CompileContext *context, Type* type);
+void checkBasicType(CompileContext *context, Type* type);
+void checkTypeEquality(CompileContext *context, Type* type1, Type* type2);
 
 #endif
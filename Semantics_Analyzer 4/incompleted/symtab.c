@@ -14,10 +14,8 @@ void freeObject(Object* obj);
 void freeScope(Scope* scope);
 void freeObjectList(ObjectNode *objList);
 void freeReferenceList(ObjectNode *objList);
+void addObject(ObjectNode **objList, Object* obj);
 
-SymTab* symtab;
-Type* intType;
-Type* charType;
 
 /******************* Type utilities ******************************/
 
@@ -41,6 +39,12 @@ Type* makeArrayType(int arraySize, Type* elementType) {
   return type;
 }
 
+Type* makeErrorType(void) {
+  Type* type = (Type*) malloc(sizeof(Type));
+  type->typeClass = TP_ERROR;
+  return type;
+}
+
 Type* duplicateType(Type* type) {
   Type* resultType = (Type*) malloc(sizeof(Type));
   resultType->typeClass = type->typeClass;
@@ -52,6 +56,8 @@ Type* duplicateType(Type* type) {
 }
 
 int compareType(Type* type1, Type* type2) {
+  if ((type1->typeClass == TP_ERROR) || (type2->typeClass == TP_ERROR))
+    return 1;
   if (type1->typeClass == type2->typeClass) {
     if (type1->typeClass == TP_ARRAY) {
       if (type1->arraySize == type2->arraySize)
@@ -62,9 +68,11 @@ int compareType(Type* type1, Type* type2) {
 }
 
 void freeType(Type* type) {
+  if (type == NULL) return;
   switch (type->typeClass) {
   case TP_INT:
   case TP_CHAR:
+  case TP_ERROR:
     free(type);
     break;
   case TP_ARRAY:
@@ -90,6 +98,13 @@ ConstantValue* makeCharConstant(char ch) {
   return value;
 }
 
+ConstantValue* makeErrorConstant(void) {
+  ConstantValue* value = (ConstantValue*) malloc(sizeof(ConstantValue));
+  value->type = TP_ERROR;
+  value->intValue = 0;
+  return value;
+}
+
 ConstantValue* duplicateConstantValue(ConstantValue* v) {
   ConstantValue* value = (ConstantValue*) malloc(sizeof(ConstantValue));
   value->type = v->type;
@@ -110,10 +125,11 @@ Scope* createScope(Object* owner, Scope* outer) {
   return scope;
 }
 
-Object* createProgramObject(char *programName) {
+Object* createProgramObject(SymTab *symtab, Atom programName) {
   Object* program = (Object*) malloc(sizeof(Object));
-  strcpy(program->name, programName);
+  program->name = programName;
   program->kind = OBJ_PROGRAM;
+  program->isError = 0;
   program->progAttrs = (ProgramAttributes*) malloc(sizeof(ProgramAttributes));
   program->progAttrs->scope = createScope(program,NULL);
   symtab->program = program;
@@ -121,61 +137,101 @@ Object* createProgramObject(char *programName) {
   return program;
 }
 
-Object* createConstantObject(char *name) {
+Object* createConstantObject(Atom name) {
   Object* obj = (Object*) malloc(sizeof(Object));
-  strcpy(obj->name, name);
+  obj->name = name;
   obj->kind = OBJ_CONSTANT;
+  obj->isError = 0;
   obj->constAttrs = (ConstantAttributes*) malloc(sizeof(ConstantAttributes));
+  obj->constAttrs->value = NULL;
   return obj;
 }
 
-Object* createTypeObject(char *name) {
+Object* createTypeObject(Atom name) {
   Object* obj = (Object*) malloc(sizeof(Object));
-  strcpy(obj->name, name);
+  obj->name = name;
   obj->kind = OBJ_TYPE;
+  obj->isError = 0;
   obj->typeAttrs = (TypeAttributes*) malloc(sizeof(TypeAttributes));
+  obj->typeAttrs->actualType = NULL;
   return obj;
 }
 
-Object* createVariableObject(char *name) {
+Object* createVariableObject(SymTab *symtab, Atom name) {
   Object* obj = (Object*) malloc(sizeof(Object));
-  strcpy(obj->name, name);
+  obj->name = name;
   obj->kind = OBJ_VARIABLE;
+  obj->isError = 0;
   obj->varAttrs = (VariableAttributes*) malloc(sizeof(VariableAttributes));
+  obj->varAttrs->type = NULL;
   obj->varAttrs->scope = symtab->currentScope;
   return obj;
 }
 
-Object* createFunctionObject(char *name) {
+Object* createFunctionObject(SymTab *symtab, Atom name) {
   Object* obj = (Object*) malloc(sizeof(Object));
-  strcpy(obj->name, name);
+  obj->name = name;
   obj->kind = OBJ_FUNCTION;
+  obj->isError = 0;
   obj->funcAttrs = (FunctionAttributes*) malloc(sizeof(FunctionAttributes));
   obj->funcAttrs->paramList = NULL;
+  obj->funcAttrs->returnType = NULL;
   obj->funcAttrs->scope = createScope(obj, symtab->currentScope);
   return obj;
 }
 
-Object* createProcedureObject(char *name) {
+Object* createProcedureObject(SymTab *symtab, Atom name) {
   Object* obj = (Object*) malloc(sizeof(Object));
-  strcpy(obj->name, name);
+  obj->name = name;
   obj->kind = OBJ_PROCEDURE;
+  obj->isError = 0;
   obj->procAttrs = (ProcedureAttributes*) malloc(sizeof(ProcedureAttributes));
   obj->procAttrs->paramList = NULL;
   obj->procAttrs->scope = createScope(obj, symtab->currentScope);
   return obj;
 }
 
-Object* createParameterObject(char *name, enum ParamKind kind, Object* owner) {
+Object* createParameterObject(Atom name, enum ParamKind kind, Object* owner) {
   Object* obj = (Object*) malloc(sizeof(Object));
-  strcpy(obj->name, name);
+  obj->name = name;
   obj->kind = OBJ_PARAMETER;
+  obj->isError = 0;
   obj->paramAttrs = (ParameterAttributes*) malloc(sizeof(ParameterAttributes));
   obj->paramAttrs->kind = kind;
+  obj->paramAttrs->type = NULL;
   obj->paramAttrs->function = owner;
   return obj;
 }
 
+Object* createErrorObject(SymTab *symtab, Atom name, enum ObjectKind kind) {
+  Object* obj;
+
+  switch (kind) {
+  case OBJ_CONSTANT:
+    obj = createConstantObject(name);
+    obj->constAttrs->value = makeErrorConstant();
+    break;
+  case OBJ_TYPE:
+    obj = createTypeObject(name);
+    obj->typeAttrs->actualType = makeErrorType();
+    break;
+  case OBJ_FUNCTION:
+    obj = createFunctionObject(symtab, name);
+    obj->funcAttrs->returnType = makeErrorType();
+    break;
+  case OBJ_PROCEDURE:
+    obj = createProcedureObject(symtab, name);
+    break;
+  default:
+    obj = createVariableObject(symtab, name);
+    obj->varAttrs->type = makeErrorType();
+    break;
+  }
+  obj->isError = 1;
+  addObject(&(symtab->errorObjectList), obj);
+  return obj;
+}
+
 void freeObject(Object* obj) {
   switch (obj->kind) {
   case OBJ_CONSTANT:
@@ -252,9 +308,9 @@ void addObject(ObjectNode **objList, Object* obj) {
   }
 }
 
-Object* findObject(ObjectNode *objList, char *name) {
+Object* findObject(ObjectNode *objList, Atom name) {
   while (objList != NULL) {
-    if (strcmp(objList->object->name, name) == 0) 
+    if (objList->object->name == name)
       return objList->object;
     else objList = objList->next;
   }
@@ -263,57 +319,64 @@ Object* findObject(ObjectNode *objList, char *name) {
 
 /******************* others ******************************/
 
-void initSymTab(void) {
+SymTab* initSymTab(void) {
+  SymTab* symtab;
   Object* obj;
   Object* param;
 
   symtab = (SymTab*) malloc(sizeof(SymTab));
+  symtab->program = NULL;
+  symtab->currentScope = NULL;
   symtab->globalObjectList = NULL;
+  symtab->errorObjectList = NULL;
   
-  obj = createFunctionObject("READC");
+  obj = createFunctionObject(symtab, internName("READC"));
   obj->funcAttrs->returnType = makeCharType();
   addObject(&(symtab->globalObjectList), obj);
 
-  obj = createFunctionObject("READI");
+  obj = createFunctionObject(symtab, internName("READI"));
   obj->funcAttrs->returnType = makeIntType();
   addObject(&(symtab->globalObjectList), obj);
 
-  obj = createProcedureObject("WRITEI");
-  param = createParameterObject("i", PARAM_VALUE, obj);
+  obj = createProcedureObject(symtab, internName("WRITEI"));
+  param = createParameterObject(internName("i"), PARAM_VALUE, obj);
   param->paramAttrs->type = makeIntType();
   addObject(&(obj->procAttrs->paramList),param);
   addObject(&(symtab->globalObjectList), obj);
 
-  obj = createProcedureObject("WRITEC");
-  param = createParameterObject("ch", PARAM_VALUE, obj);
+  obj = createProcedureObject(symtab, internName("WRITEC"));
+  param = createParameterObject(internName("ch"), PARAM_VALUE, obj);
   param->paramAttrs->type = makeCharType();
   addObject(&(obj->procAttrs->paramList),param);
   addObject(&(symtab->globalObjectList), obj);
 
-  obj = createProcedureObject("WRITELN");
+  obj = createProcedureObject(symtab, internName("WRITELN"));
   addObject(&(symtab->globalObjectList), obj);
 
-  intType = makeIntType();
-  charType = makeCharType();
+  symtab->intType = makeIntType();
+  symtab->charType = makeCharType();
+  return symtab;
 }
 
-void cleanSymTab(void) {
-  freeObject(symtab->program);
+void cleanSymTab(SymTab *symtab) {
+  if (symtab->program != NULL)
+    freeObject(symtab->program);
   freeObjectList(symtab->globalObjectList);
+  freeObjectList(symtab->errorObjectList);
+  freeType(symtab->intType);
+  freeType(symtab->charType);
   free(symtab);
-  freeType(intType);
-  freeType(charType);
 }
 
-void enterBlock(Scope* scope) {
+void enterBlock(SymTab *symtab, Scope* scope) {
   symtab->currentScope = scope;
 }
 
-void exitBlock(void) {
+void exitBlock(SymTab *symtab) {
   symtab->currentScope = symtab->currentScope->outer;
 }
 
-void declareObject(Object* obj) {
+void declareObject(SymTab *symtab, Object* obj) {
   if (obj->kind == OBJ_PARAMETER) {
     Object* owner = symtab->currentScope->owner;
     switch (owner->kind) {
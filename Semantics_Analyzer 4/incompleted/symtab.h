@@ -12,7 +12,8 @@
 enum TypeClass {
   TP_INT,
   TP_CHAR,
-  TP_ARRAY
+  TP_ARRAY,
+  TP_ERROR          /* of what an error left undetermined */
 };
 
 enum ObjectKind {
@@ -97,8 +98,9 @@ typedef struct ProgramAttributes_ ProgramAttributes;
 typedef struct ParameterAttributes_ ParameterAttributes;
 
 struct Object_ {
-  char name[MAX_IDENT_LEN];
+  Atom name;
   enum ObjectKind kind;
+  int isError;              /* made by createErrorObject */
   union {
     ConstantAttributes* constAttrs;
     VariableAttributes* varAttrs;
@@ -131,6 +133,9 @@ struct SymTab_ {
   Object* program;
   Scope* currentScope;
   ObjectNode *globalObjectList;
+  ObjectNode *errorObjectList;   /* the error objects, freed with the table */
+  Type* intType;
+  Type* charType;
 };
 
 typedef struct SymTab_ SymTab;
@@ -138,30 +143,39 @@ typedef struct SymTab_ SymTab;
 Type* makeIntType(void);
 Type* makeCharType(void);
 Type* makeArrayType(int arraySize, Type* elementType);
+/* The error type is compatible with every type, so that an error is not
+ * reported again by each check of what it left undetermined */
+Type* makeErrorType(void);
 Type* duplicateType(Type* type);
 int compareType(Type* type1, Type* type2);
 void freeType(Type* type);
 
 ConstantValue* makeIntConstant(int i);
 ConstantValue* makeCharConstant(char ch);
+ConstantValue* makeErrorConstant(void);
 ConstantValue* duplicateConstantValue(ConstantValue* v);
 
 Scope* createScope(Object* owner, Scope* outer);
 
-Object* createProgramObject(char *programName);
-Object* createConstantObject(char *name);
-Object* createTypeObject(char *name);
-Object* createVariableObject(char *name);
-Object* createFunctionObject(char *name);
-Object* createProcedureObject(char *name);
-Object* createParameterObject(char *name, enum ParamKind kind, Object* owner);
-
-Object* findObject(ObjectNode *objList, char *name);
-
-void initSymTab(void);
-void cleanSymTab(void);
-void enterBlock(Scope* scope);
-void exitBlock(void);
-void declareObject(Object* obj);
+Object* createProgramObject(SymTab *symtab, Atom programName);
+Object* createConstantObject(Atom name);
+Object* createTypeObject(Atom name);
+Object* createVariableObject(SymTab *symtab, Atom name);
+Object* createFunctionObject(SymTab *symtab, Atom name);
+Object* createProcedureObject(SymTab *symtab, Atom name);
+Object* createParameterObject(Atom name, enum ParamKind kind, Object* owner);
+/* Stands in for an undeclared object, or one of another kind: its types
+ * and value are of the error type, and a function or procedure takes any
+ * arguments. It is not declared anywhere. */
+Object* createErrorObject(SymTab *symtab, Atom name, enum ObjectKind kind);
+
+Object* findObject(ObjectNode *objList, Atom name);
+
+/* Each compilation has a symbol table of its own */
+SymTab* initSymTab(void);
+void cleanSymTab(SymTab *symtab);
+void enterBlock(SymTab *symtab, Scope* scope);
+void exitBlock(SymTab *symtab);
+void declareObject(SymTab *symtab, Object* obj);
 
 #endif
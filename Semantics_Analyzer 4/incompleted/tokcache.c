@@ -0,0 +1,400 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "reader.h"
+#include "token.h"
+#include "tokstream.h"
+#include "tokcache.h"
+
+/* The tables the cached tokens were lexed with. They are static, so
+ * this file has its own copy to take the version from. */
+#include "keywords.h"
+#include "lexer.h"
+
+/* Bump when the layout below, or the tokens and errors lexing gives,
+ * change; 2 since identifiers have no length limit */
+#define TOKEN_CACHE_FORMAT 2
+#define TOKEN_CACHE_MAGIC "KPLTOKS"
+#define MAX_PATH_LEN 1024
+
+/* A cache file is this header followed by the sections, each starting
+ * on an 8 byte boundary:
+ *   types[count], offsets[count], lengths[count], values[count]
+ *   nameOffsets[nameCount + 1], names[namesSize]
+ * The value of an identifier is its index in the name table, since
+ * atoms are only good for the process that interned them. */
+typedef struct {
+  char magic[8];
+  uint64_t version;
+  uint64_t sourceHash;
+  uint64_t sourceSize;
+  uint64_t contentHash;     /* of the sections, see hashSections */
+  uint32_t count;
+  uint32_t failed;
+  uint32_t nameCount;
+  uint32_t namesSize;
+  SourceOffset errorOffset;
+  char errorMessage[MAX_MESSAGE_LEN];
+} CacheHeader;
+
+typedef struct {
+  size_t types, offsets, lengths, values, nameOffsets, names;
+  size_t size;
+} CacheLayout;
+
+/******************* XXH64 ******************************/
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t read32(const unsigned char *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t hashRound(uint64_t acc, uint64_t input) {
+  acc += input * PRIME64_2;
+  acc = rotl64(acc, 31);
+  return acc * PRIME64_1;
+}
+
+static inline uint64_t mergeRound(uint64_t acc, uint64_t val) {
+  acc ^= hashRound(0, val);
+  return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed) {
+  const unsigned char *p = (const unsigned char*) data;
+  const unsigned char *limit = p + size;
+  uint64_t h;
+
+  if (size >= 32) {
+    uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+    uint64_t v2 = seed + PRIME64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - PRIME64_1;
+
+    do {
+      v1 = hashRound(v1, read64(p));
+      v2 = hashRound(v2, read64(p + 8));
+      v3 = hashRound(v3, read64(p + 16));
+      v4 = hashRound(v4, read64(p + 24));
+      p += 32;
+    } while (p + 32 <= limit);
+
+    h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+    h = mergeRound(h, v1);
+    h = mergeRound(h, v2);
+    h = mergeRound(h, v3);
+    h = mergeRound(h, v4);
+  } else h = seed + PRIME64_5;
+
+  h += (uint64_t) size;
+
+  for (; p + 8 <= limit; p += 8)
+    h = rotl64(h ^ hashRound(0, read64(p)), 27) * PRIME64_1 + PRIME64_4;
+  if (p + 4 <= limit) {
+    h = rotl64(h ^ (read32(p) * PRIME64_1), 23) * PRIME64_2 + PRIME64_3;
+    p += 4;
+  }
+  for (; p < limit; p ++)
+    h = rotl64(h ^ (*p * PRIME64_5), 11) * PRIME64_1;
+
+  h ^= h >> 33;
+  h *= PRIME64_2;
+  h ^= h >> 29;
+  h *= PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+/******************* cache files ******************************/
+
+/* Changes whenever the keyword table, the lexer tables or the token
+ * numbering do, so that another grammar never reads these entries */
+uint64_t cacheVersion(void) {
+  uint64_t version = TOKEN_CACHE_FORMAT;
+
+  version = hashBytes(keywordCharValue, sizeof(keywordCharValue), version);
+  version = hashBytes(keywordTable, sizeof(keywordTable), version);
+  version = hashBytes(lexClass, sizeof(lexClass), version);
+  version = hashBytes(lexNext, sizeof(lexNext), version);
+  version = hashBytes(lexAccept, sizeof(lexAccept), version);
+  return version ^ ((uint64_t) SB_RSEL << 32) ^ MAX_IDENT_LEN;
+}
+
+size_t alignSection(size_t offset) {
+  return (offset + 7) & ~(size_t) 7;
+}
+
+void layOutCache(CacheLayout *layout, uint32_t count, uint32_t nameCount, uint32_t namesSize) {
+  layout->types = alignSection(sizeof(CacheHeader));
+  layout->offsets = alignSection(layout->types + count * sizeof(uint8_t));
+  layout->lengths = alignSection(layout->offsets + count * sizeof(SourceOffset));
+  layout->values = alignSection(layout->lengths + count * sizeof(uint16_t));
+  layout->nameOffsets = alignSection(layout->values + count * sizeof(uint32_t));
+  layout->names = layout->nameOffsets + ((size_t) nameCount + 1) * sizeof(uint32_t);
+  layout->size = layout->names + namesSize;
+}
+
+/* Hashes the sections without the padding between them */
+uint64_t hashSections(const void *types, const void *offsets, const void *lengths, const void *values,
+                      const void *nameOffsets, const void *names,
+                      uint32_t count, uint32_t nameCount, uint32_t namesSize) {
+  uint64_t h = 0;
+
+  h = hashBytes(types, count * sizeof(uint8_t), h);
+  h = hashBytes(offsets, count * sizeof(SourceOffset), h);
+  h = hashBytes(lengths, count * sizeof(uint16_t), h);
+  h = hashBytes(values, count * sizeof(uint32_t), h);
+  h = hashBytes(nameOffsets, ((size_t) nameCount + 1) * sizeof(uint32_t), h);
+  return hashBytes(names, namesSize, h);
+}
+
+void cachePath(char *path, const char *directory, uint64_t sourceHash) {
+  snprintf(path, MAX_PATH_LEN, "%s/%016llx.tok", directory, (unsigned long long) sourceHash);
+}
+
+/* Checks the content hash, and everything readStreamToken will rely
+ * on, so that a damaged entry is a miss rather than wrong tokens */
+int validCache(const char *base, size_t fileSize, const CacheHeader *header, const CacheLayout *layout) {
+  const uint8_t *types = (const uint8_t*) (base + layout->types);
+  const SourceOffset *offsets = (const SourceOffset*) (base + layout->offsets);
+  const uint16_t *lengths = (const uint16_t*) (base + layout->lengths);
+  const uint32_t *values = (const uint32_t*) (base + layout->values);
+  const uint32_t *nameOffsets = (const uint32_t*) (base + layout->nameOffsets);
+  const char *names = base + layout->names;
+  uint32_t i;
+
+  if ((layout->size != fileSize) || ((header->count == 0) && !header->failed))
+    return 0;
+  if (hashSections(types, offsets, lengths, values, nameOffsets, names,
+                   header->count, header->nameCount, header->namesSize) != header->contentHash)
+    return 0;
+
+  for (i = 0; i < header->count; i++) {
+    if ((types[i] > SB_RSEL) || (offsets[i] > header->sourceSize) ||
+        (lengths[i] > header->sourceSize - offsets[i]))
+      return 0;
+    if ((types[i] == TK_IDENT) && (values[i] >= header->nameCount))
+      return 0;
+  }
+
+  if ((nameOffsets[0] != 0) || (nameOffsets[header->nameCount] != header->namesSize))
+    return 0;
+  for (i = 0; i < header->nameCount; i++)
+    if ((nameOffsets[i + 1] <= nameOffsets[i]) || (nameOffsets[i + 1] > header->namesSize) ||
+        (names[nameOffsets[i + 1] - 1] != '\0'))
+      return 0;
+  return 1;
+}
+
+TokenStream *loadTokenCache(const char *directory, Scanner *scanner) {
+  const char *text = scanner->input.base;
+  size_t size = scanner->input.size;
+  uint64_t sourceHash = hashBytes(text, size, 0);
+  char path[MAX_PATH_LEN];
+  CacheHeader header;
+  CacheLayout layout;
+  TokenStream *stream;
+  struct stat st;
+  const char *base;
+  const uint32_t *values, *nameOffsets;
+  Atom *atoms;
+  void *mapping;
+  uint32_t i;
+  int fd;
+
+  cachePath(path, directory, sourceHash);
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  if ((fstat(fd, &st) != 0) || (st.st_size < (off_t) sizeof(CacheHeader)) ||
+      (read(fd, &header, sizeof(header)) != sizeof(header))) {
+    close(fd);
+    return NULL;
+  }
+  if ((memcmp(header.magic, TOKEN_CACHE_MAGIC, sizeof(header.magic)) != 0) ||
+      (header.version != cacheVersion()) || (header.sourceHash != sourceHash) ||
+      (header.sourceSize != size)) {
+    close(fd);
+    return NULL;
+  }
+
+  // private and writable, so that a re-lex can edit the arrays in place
+  mapping = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return NULL;
+
+  base = (const char*) mapping;
+  layOutCache(&layout, header.count, header.nameCount, header.namesSize);
+  if (!validCache(base, st.st_size, &header, &layout)) {
+    munmap(mapping, st.st_size);
+    return NULL;
+  }
+
+  // identifiers get the atoms of this process, one lookup per name
+  nameOffsets = (const uint32_t*) (base + layout.nameOffsets);
+  atoms = (Atom*) malloc((header.nameCount + 1) * sizeof(Atom));
+  for (i = 0; i < header.nameCount; i++) {
+    atoms[i] = internRun(base + layout.names + nameOffsets[i], nameOffsets[i + 1] - nameOffsets[i] - 1);
+    // lexing the source again reports it
+    if (atoms[i] == NO_ATOM) {
+      free(atoms);
+      munmap(mapping, st.st_size);
+      return NULL;
+    }
+  }
+
+  stream = (TokenStream*) calloc(1, sizeof(TokenStream));
+  stream->text = text;
+  stream->textLimit = text + size;
+  stream->mapping = mapping;
+  stream->mappingSize = st.st_size;
+  stream->types = (uint8_t*) (base + layout.types);
+  stream->offsets = (SourceOffset*) (base + layout.offsets);
+  stream->lengths = (uint16_t*) (base + layout.lengths);
+  stream->count = stream->capacity = header.count;
+
+  values = (const uint32_t*) (base + layout.values);
+  stream->values = (uint32_t*) malloc(header.count * sizeof(uint32_t));
+  for (i = 0; i < header.count; i++)
+    stream->values[i] = (stream->types[i] == TK_IDENT) ? atoms[values[i]] : values[i];
+  free(atoms);
+
+  stream->failed = header.failed;
+  if (stream->failed) {
+    stream->diagnostic.offset = header.errorOffset;
+    memcpy(stream->diagnostic.message, header.errorMessage, MAX_MESSAGE_LEN);
+    stream->diagnostic.message[MAX_MESSAGE_LEN - 1] = '\0';
+  }
+  return stream;
+}
+
+int writeSection(FILE *f, const void *data, size_t size, size_t at) {
+  static const char padding[8];
+  long position = ftell(f);
+
+  if ((position < 0) || ((size_t) position > at) ||
+      (fwrite(padding, 1, at - position, f) != at - (size_t) position))
+    return 0;
+  return fwrite(data, 1, size, f) == size;
+}
+
+int storeTokenCache(const char *directory, TokenStream *stream) {
+  size_t size = stream->textLimit - stream->text;
+  uint32_t count = stream->count, nameCount = 0, namesSize = 0;
+  uint32_t *values, *nameOffsets, *slots;
+  uint32_t slotMask, i;
+  char path[MAX_PATH_LEN], temporary[MAX_PATH_LEN + 8];
+  char *names;
+  CacheHeader header;
+  CacheLayout layout;
+  FILE *f;
+  int fd, ok;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TOKEN_CACHE_MAGIC, sizeof(header.magic));
+  header.version = cacheVersion();
+  header.sourceHash = hashBytes(stream->text, size, 0);
+  header.sourceSize = size;
+
+  // number the distinct identifiers; slots maps an atom to its number + 1
+  for (slotMask = 64; slotMask < 2 * count; slotMask <<= 1) ;
+  slots = (uint32_t*) calloc(slotMask, sizeof(uint32_t));
+  slotMask --;
+  values = (uint32_t*) malloc(count * sizeof(uint32_t));
+  nameOffsets = (uint32_t*) malloc((count + 1) * sizeof(uint32_t));
+  names = NULL;
+  nameOffsets[0] = 0;
+
+  for (i = 0; i < count; i++) {
+    uint32_t atom = stream->values[i], slot;
+
+    values[i] = atom;
+    if (stream->types[i] != TK_IDENT) continue;
+
+    for (slot = (atom * 2654435761u) & slotMask; slots[slot] != 0; slot = (slot + 1) & slotMask)
+      if (stream->values[slots[slot] - 1] == atom) break;
+
+    if (slots[slot] == 0) {
+      const char *name = atomName(atom);
+      size_t length = strlen(name) + 1;
+
+      slots[slot] = i + 1;
+      names = (char*) realloc(names, namesSize + length);
+      memcpy(names + namesSize, name, length);
+      namesSize += length;
+      values[i] = nameCount;
+      nameOffsets[++ nameCount] = namesSize;
+    } else values[i] = values[slots[slot] - 1];
+  }
+  free(slots);
+
+  header.count = count;
+  header.nameCount = nameCount;
+  header.namesSize = namesSize;
+  header.failed = stream->failed;
+  if (stream->failed) {
+    header.errorOffset = stream->diagnostic.offset;
+    memcpy(header.errorMessage, stream->diagnostic.message, MAX_MESSAGE_LEN);
+  }
+  layOutCache(&layout, count, nameCount, namesSize);
+  header.contentHash = hashSections(stream->types, stream->offsets, stream->lengths, values,
+                                    nameOffsets, names, count, nameCount, namesSize);
+
+  // written aside and renamed, so readers never see half an entry
+  cachePath(path, directory, header.sourceHash);
+  snprintf(temporary, sizeof(temporary), "%s.XXXXXX", path);
+  fd = mkstemp(temporary);
+  if (fd >= 0)
+    fchmod(fd, 0644);
+  f = (fd < 0) ? NULL : fdopen(fd, "wb");
+  ok = (f != NULL) &&
+    (fwrite(&header, sizeof(header), 1, f) == 1) &&
+    writeSection(f, stream->types, count * sizeof(uint8_t), layout.types) &&
+    writeSection(f, stream->offsets, count * sizeof(SourceOffset), layout.offsets) &&
+    writeSection(f, stream->lengths, count * sizeof(uint16_t), layout.lengths) &&
+    writeSection(f, values, count * sizeof(uint32_t), layout.values) &&
+    writeSection(f, nameOffsets, (nameCount + 1) * sizeof(uint32_t), layout.nameOffsets) &&
+    writeSection(f, names, namesSize, layout.names);
+
+  if (f != NULL) {
+    if (fclose(f) != 0) ok = 0;
+  } else if (fd >= 0) close(fd);
+  if (fd >= 0) {
+    if (ok) ok = (rename(temporary, path) == 0);
+    if (!ok) unlink(temporary);
+  }
+
+  free(values);
+  free(nameOffsets);
+  free(names);
+  return ok;
+}
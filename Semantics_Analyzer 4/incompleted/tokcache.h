@@ -0,0 +1,34 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __TOKCACHE_H__
+#define __TOKCACHE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "tokstream.h"
+
+/* An on-disk cache of token streams, one file per distinct source text,
+ * named after a 64-bit hash of its bytes. Each file records the version
+ * of the lexer and keyword tables it was made with, so entries written
+ * by a build with another grammar are ignored and replaced.
+ *
+ * A hit maps the file back: the types, offsets and lengths of the
+ * tokens are read from the mapping as they are, and only identifiers
+ * are interned again, once per distinct name. */
+
+/* XXH64 of size bytes at data */
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed);
+
+/* The stream of the scanner's whole input from the cache in directory,
+ * or NULL on a miss */
+TokenStream *loadTokenCache(const char *directory, Scanner *scanner);
+
+/* Adds stream to the cache in directory; returns 0 if it could not be
+ * written, which only costs the next compilation a lexing pass */
+int storeTokenCache(const char *directory, TokenStream *stream);
+
+#endif
@@ -5,56 +5,43 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 #include "token.h"
 
-struct {
-  char string[MAX_IDENT_LEN + 1];
-  TokenType tokenType;
-} keywords[KEYWORDS_COUNT] = {
-  {"PROGRAM", KW_PROGRAM},
-  {"CONST", KW_CONST},
-  {"TYPE", KW_TYPE},
-  {"VAR", KW_VAR},
-  {"INTEGER", KW_INTEGER},
-  {"CHAR", KW_CHAR},
-  {"ARRAY", KW_ARRAY},
-  {"OF", KW_OF},
-  {"FUNCTION", KW_FUNCTION},
-  {"PROCEDURE", KW_PROCEDURE},
-  {"BEGIN", KW_BEGIN},
-  {"END", KW_END},
-  {"CALL", KW_CALL},
-  {"IF", KW_IF},
-  {"THEN", KW_THEN},
-  {"ELSE", KW_ELSE},
-  {"WHILE", KW_WHILE},
-  {"DO", KW_DO},
-  {"FOR", KW_FOR},
-  {"TO", KW_TO}
-};
+/* Perfect hash table generated by kwgen from keywords.def */
+#include "keywords.h"
 
-int keywordEq(char *kw, char *string) {
-  while ((*kw != '\0') && (*string != '\0')) {
-    if (*kw != *string) break;
-    kw ++; string ++;
-  }
-  return ((*kw == '\0') && (*string == '\0'));
+TokenType lookupKeyword(const char *key, int length) {
+  int slot;
+
+  if ((length == 0) || (length > KEYWORD_MAX_LEN))
+    return TK_NONE;
+
+  slot = (length + keywordCharValue[(unsigned char) key[0]] + keywordCharValue[(unsigned char) key[length - 1]])
+    % KEYWORD_TABLE_SIZE;
+
+  if (memcmp(keywordTable[slot].string, key, MAX_IDENT_LEN + 1) == 0)
+    return keywordTable[slot].tokenType;
+  return TK_NONE;
 }
 
 TokenType checkKeyword(char *string) {
-  int i;
-  for (i = 0; i < KEYWORDS_COUNT; i++)
-    if (keywordEq(keywords[i].string, string)) 
-      return keywords[i].tokenType;
-  return TK_NONE;
+  char key[MAX_IDENT_LEN + 1];
+  size_t length = strlen(string);
+
+  if (length > KEYWORD_MAX_LEN)
+    return TK_NONE;
+
+  memset(key, 0, sizeof(key));
+  memcpy(key, string, length);
+  return lookupKeyword(key, length);
 }
 
-Token* makeToken(TokenType tokenType, int lineNo, int colNo) {
+Token* makeToken(TokenType tokenType, SourceOffset offset) {
   Token *token = (Token*)malloc(sizeof(Token));
   token->tokenType = tokenType;
-  token->lineNo = lineNo;
-  token->colNo = colNo;
+  token->offset = offset;
   return token;
 }
 
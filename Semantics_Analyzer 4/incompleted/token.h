@@ -7,8 +7,12 @@
 #ifndef __TOKEN_H__
 #define __TOKEN_H__
 
+#include "reader.h"
+#include "atom.h"
+
+/* Identifiers may be of any length; the string of a token only holds
+ * this many characters of one, the atom names all of it */
 #define MAX_IDENT_LEN 15
-#define KEYWORDS_COUNT 20
 
 typedef enum {
   TK_NONE, TK_IDENT, TK_NUMBER, TK_CHAR, TK_EOF,
@@ -28,13 +32,17 @@ typedef enum {
 
 typedef struct {
   char string[MAX_IDENT_LEN + 1];
-  int lineNo, colNo;
+  SourceOffset offset;
   TokenType tokenType;
   int value;
+  Atom atom;              /* the interned name of a TK_IDENT */
 } Token;
 
 TokenType checkKeyword(char *string);
-Token* makeToken(TokenType tokenType, int lineNo, int colNo);
+/* Same as checkKeyword, for a key of the given length already padded
+ * with zeros to MAX_IDENT_LEN + 1 bytes */
+TokenType lookupKeyword(const char *key, int length);
+Token* makeToken(TokenType tokenType, SourceOffset offset);
 char *tokenToString(TokenType tokenType);
 
 
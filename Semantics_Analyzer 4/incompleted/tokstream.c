@@ -0,0 +1,451 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "reader.h"
+#include "scanner.h"
+#include "charscan.h"
+#include "tokstream.h"
+
+#define MIN_STREAM_CAPACITY 1024
+#define MIN_RELEX_CAPACITY 64
+#define MIN_PARALLEL_CHUNK (4 << 20)
+#define MAX_LEX_THREADS 64
+
+/* A piece of the input lexed on a thread of its own. Lexing starts at
+ * the beginning of a line, as if no comment were open there, and keeps
+ * the tokens that start before end, the start of the next chunk; the
+ * token there and those after it are the next chunk's. */
+typedef struct {
+  const char *text;
+  size_t size;
+  SourceOffset start;
+  size_t end;
+  SourceOffset resume;      /* where the last token kept ends */
+  TokenStream *stream;
+  AtomTable *atoms;         /* the table of the thread that split the input */
+  pthread_t thread;
+  int threaded;
+} LexChunk;
+
+void growTokenStream(TokenStream *stream, int capacity) {
+  // arrays mapped from the token cache are copied out before they grow
+  if (stream->mapping != NULL) {
+    uint8_t *types = (uint8_t*) malloc(capacity * sizeof(uint8_t));
+    SourceOffset *offsets = (SourceOffset*) malloc(capacity * sizeof(SourceOffset));
+    uint16_t *lengths = (uint16_t*) malloc(capacity * sizeof(uint16_t));
+
+    memcpy(types, stream->types, stream->count * sizeof(uint8_t));
+    memcpy(offsets, stream->offsets, stream->count * sizeof(SourceOffset));
+    memcpy(lengths, stream->lengths, stream->count * sizeof(uint16_t));
+    munmap(stream->mapping, stream->mappingSize);
+    stream->mapping = NULL;
+    stream->types = types;
+    stream->offsets = offsets;
+    stream->lengths = lengths;
+  }
+
+  stream->types = (uint8_t*) realloc(stream->types, capacity * sizeof(uint8_t));
+  stream->offsets = (SourceOffset*) realloc(stream->offsets, capacity * sizeof(SourceOffset));
+  stream->lengths = (uint16_t*) realloc(stream->lengths, capacity * sizeof(uint16_t));
+  stream->values = (uint32_t*) realloc(stream->values, capacity * sizeof(uint32_t));
+  stream->capacity = capacity;
+}
+
+void appendToken(TokenStream *stream, Token *token, SourceOffset end) {
+  int i = stream->count;
+  SourceOffset length = end - token->offset;
+
+  if (i == stream->capacity)
+    growTokenStream(stream, 2 * stream->capacity);
+
+  stream->types[i] = (uint8_t) token->tokenType;
+  stream->offsets[i] = token->offset;
+  stream->lengths[i] = (length > UINT16_MAX) ? UINT16_MAX : (uint16_t) length;
+  switch (token->tokenType) {
+  case TK_NUMBER: stream->values[i] = (uint32_t) token->value; break;
+  case TK_CHAR: stream->values[i] = (unsigned char) token->string[0]; break;
+  case TK_IDENT: stream->values[i] = token->atom; break;
+  default: stream->values[i] = 0;
+  }
+  stream->count ++;
+}
+
+TokenStream *tokenizeInput(Scanner *scanner) {
+  TokenStream *stream = (TokenStream*) calloc(1, sizeof(TokenStream));
+  Scanner *previousSource;
+  ErrorTrap trap;
+  Token token;
+  int capacity = scanner->input.size / 4;
+
+  stream->text = scanner->input.base;
+  stream->textLimit = scanner->input.limit;
+
+  // about one token per four bytes of typical source
+  if (capacity < MIN_STREAM_CAPACITY) capacity = MIN_STREAM_CAPACITY;
+  growTokenStream(stream, capacity);
+
+  previousSource = setErrorSource(scanner);
+  armErrorTrap(&trap);
+  if (setjmp(trap.env) == 0) {
+    do {
+      readValidToken(scanner, &token);
+      appendToken(stream, &token, currentOffset(scanner));
+    } while (token.tokenType != TK_EOF);
+  } else {
+    stream->failed = 1;
+    stream->diagnostic = trap.diagnostic;
+  }
+  disarmErrorTrap();
+  setErrorSource(previousSource);
+
+  return stream;
+}
+
+void *lexChunk(void *argument) {
+  LexChunk *chunk = (LexChunk*) argument;
+  TokenStream *stream = (TokenStream*) calloc(1, sizeof(TokenStream));
+  Scanner source, *scanner = &source;
+  Scanner *previousSource;
+  AtomTable *previousAtoms;
+  ErrorTrap trap;
+  Token token;
+  int capacity = (chunk->end - chunk->start) / 4;
+
+  stream->text = chunk->text;
+  stream->textLimit = chunk->text + chunk->size;
+  if (capacity < MIN_STREAM_CAPACITY) capacity = MIN_STREAM_CAPACITY;
+  growTokenStream(stream, capacity);
+
+  useInputBuffer(scanner, chunk->text, chunk->size);
+  seekChar(scanner, chunk->text + chunk->start);
+  chunk->resume = chunk->start;
+
+  previousSource = setErrorSource(NULL);
+  previousAtoms = setAtomTable(chunk->atoms);
+  armErrorTrap(&trap);
+  if (setjmp(trap.env) == 0) {
+    do {
+      readValidToken(scanner, &token);
+      if (token.offset >= chunk->end)
+        break;
+      appendToken(stream, &token, currentOffset(scanner));
+      chunk->resume = currentOffset(scanner);
+    } while (token.tokenType != TK_EOF);
+  } else {
+    stream->failed = 1;
+    stream->diagnostic = trap.diagnostic;
+  }
+  disarmErrorTrap();
+  setAtomTable(previousAtoms);
+  setErrorSource(previousSource);
+  closeInputStream(scanner);
+
+  chunk->stream = stream;
+  return NULL;
+}
+
+/* Index of the token of stream that starts at offset, or -1 */
+int findToken(TokenStream *stream, SourceOffset offset) {
+  int low = 0, high = stream->count, mid;
+
+  while (low < high) {
+    mid = (low + high) / 2;
+    if (stream->offsets[mid] < offset) low = mid + 1;
+    else high = mid;
+  }
+  if ((low < stream->count) && (stream->offsets[low] == offset))
+    return low;
+  return -1;
+}
+
+/* Appends the tokens of from, starting with token first */
+void appendTokens(TokenStream *stream, TokenStream *from, int first) {
+  int count = from->count - first, i = stream->count;
+
+  if (i + count > stream->capacity)
+    growTokenStream(stream, i + count + (i + count) / 2);
+  memcpy(stream->types + i, from->types + first, count * sizeof(uint8_t));
+  memcpy(stream->offsets + i, from->offsets + first, count * sizeof(SourceOffset));
+  memcpy(stream->lengths + i, from->lengths + first, count * sizeof(uint16_t));
+  memcpy(stream->values + i, from->values + first, count * sizeof(uint32_t));
+  stream->count += count;
+}
+
+TokenStream *tokenizeInputParallel(Scanner *scanner, int threads) {
+  LexChunk chunks[MAX_LEX_THREADS];
+  const char *text = scanner->input.base, *p;
+  size_t size = scanner->input.limit - scanner->input.base;
+  SourceOffset start = currentOffset(scanner);
+  TokenStream *stream, *spec;
+  Scanner source;
+  Scanner *previousSource;
+  ErrorTrap trap;
+  Token token;
+  size_t boundary;
+  int next = 1, first, k;
+
+  if (threads <= 0)
+    threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  if ((size - start) / MIN_PARALLEL_CHUNK < (size_t) threads)
+    threads = (int) ((size - start) / MIN_PARALLEL_CHUNK);
+  if (threads > MAX_LEX_THREADS)
+    threads = MAX_LEX_THREADS;
+  if ((threads < 2) || (scanner->input.kind == INPUT_STREAM) || (scanner->input.origin != 0))
+    return tokenizeInput(scanner);
+
+  // tokens never span lines, only comments do, so the chunks are cut
+  // after a newline
+  for (k = 0; k < threads; k++) {
+    chunks[k].text = text;
+    chunks[k].size = size;
+    chunks[k].start = start;
+    chunks[k].end = size + 1;
+    chunks[k].atoms = getAtomTable();
+    chunks[k].threaded = 0;
+    if (k > 0) {
+      boundary = start + (size - start) / threads * k;
+      if (boundary < chunks[k - 1].start)
+        boundary = chunks[k - 1].start;
+      p = (const char*) memchr(text + boundary, '\n', size - boundary);
+      chunks[k].start = (p == NULL) ? size : (SourceOffset) (p + 1 - text);
+      chunks[k - 1].end = chunks[k].start;
+    }
+  }
+
+  for (k = 1; k < threads; k++)
+    chunks[k].threaded = (pthread_create(&chunks[k].thread, NULL, lexChunk, &chunks[k]) == 0);
+  lexChunk(&chunks[0]);
+  for (k = 1; k < threads; k++) {
+    if (chunks[k].threaded) pthread_join(chunks[k].thread, NULL);
+    else lexChunk(&chunks[k]);
+  }
+
+  // the first chunk was lexed from where the scanner was, so its tokens
+  // are right. Lexing goes on from its end until a token starts where a
+  // token of a later chunk started too: from there on, that chunk's
+  // tokens are right as well. A chunk that started inside a comment or
+  // a char constant only lines up once it has been lexed past the end
+  // of it, and one that never does is lexed again here in full.
+  stream = chunks[0].stream;
+  if (!stream->failed && ((stream->count == 0) || (stream->types[stream->count - 1] != TK_EOF))) {
+    useInputBuffer(&source, text, size);
+    seekChar(&source, text + chunks[0].resume);
+
+    previousSource = setErrorSource(NULL);
+    armErrorTrap(&trap);
+    if (setjmp(trap.env) == 0) {
+      for (;;) {
+        readValidToken(&source, &token);
+        while ((next < threads) && (token.offset >= chunks[next].end))
+          next ++;
+
+        if ((next < threads) && ((first = findToken(chunks[next].stream, token.offset)) >= 0)) {
+          spec = chunks[next].stream;
+          appendTokens(stream, spec, first);
+          if (spec->failed) {
+            stream->failed = 1;
+            stream->diagnostic = spec->diagnostic;
+            break;
+          }
+          if (stream->types[stream->count - 1] == TK_EOF)
+            break;
+          seekChar(&source, text + chunks[next].resume);
+          next ++;
+          continue;
+        }
+
+        appendToken(stream, &token, currentOffset(&source));
+        if (token.tokenType == TK_EOF)
+          break;
+      }
+    } else {
+      stream->failed = 1;
+      stream->diagnostic = trap.diagnostic;
+    }
+    disarmErrorTrap();
+    setErrorSource(previousSource);
+    closeInputStream(&source);
+  }
+
+  if (stream->failed)
+    locateOffset(scanner, stream->diagnostic.offset, &stream->diagnostic.lineNo, &stream->diagnostic.colNo);
+  for (k = 1; k < threads; k++)
+    freeTokenStream(chunks[k].stream);
+  return stream;
+}
+
+void freeTokenStream(TokenStream *stream) {
+  if (stream == NULL) return;
+  if (stream->mapping != NULL)
+    munmap(stream->mapping, stream->mappingSize);
+  else {
+    free(stream->types);
+    free(stream->offsets);
+    free(stream->lengths);
+  }
+  free(stream->values);
+  free(stream);
+}
+
+/* Index of the last token that ends before offset, or -1. The DFA is
+ * back at its start state at the end of that token, and it stopped there
+ * on a byte the edit did not touch, so lexing can restart from it. A
+ * length saturated at UINT16_MAX does not say where its token ends. */
+int findRestartToken(TokenStream *stream, SourceOffset offset) {
+  int low = 0, high = stream->count, mid, k;
+
+  // the first token starting at or after offset
+  while (low < high) {
+    mid = (low + high) / 2;
+    if (stream->offsets[mid] < offset) low = mid + 1;
+    else high = mid;
+  }
+
+  for (k = low - 1; k >= 0; k--)
+    if ((stream->lengths[k] < UINT16_MAX) && (stream->offsets[k] + stream->lengths[k] < offset))
+      break;
+  return k;
+}
+
+void moveTokens(TokenStream *stream, int to, int from, int count) {
+  memmove(stream->types + to, stream->types + from, count * sizeof(uint8_t));
+  memmove(stream->offsets + to, stream->offsets + from, count * sizeof(SourceOffset));
+  memmove(stream->lengths + to, stream->lengths + from, count * sizeof(uint16_t));
+  memmove(stream->values + to, stream->values + from, count * sizeof(uint32_t));
+}
+
+void relexTokenStream(TokenStream *stream, const char *text, size_t size,
+                      SourceOffset offset, SourceOffset removed, SourceOffset inserted,
+                      TokenEdit *edit) {
+  TokenStream *fresh = (TokenStream*) calloc(1, sizeof(TokenStream));
+  Scanner source, *scanner = &source;
+  Scanner *previousSource;
+  ErrorTrap trap;
+  Token token;
+  SourceOffset start = 0, target;
+  int first = findRestartToken(stream, offset) + 1;
+  int old = first, synced = 0, kept, count, i;
+
+  if (first > 0)
+    start = stream->offsets[first - 1] + stream->lengths[first - 1];
+  growTokenStream(fresh, MIN_RELEX_CAPACITY);
+
+  useInputBuffer(scanner, text, size);
+  seekChar(scanner, text + start);
+
+  // errors are located when the stream raises them, not here, so that
+  // an edit does not have to index the lines of the whole text
+  previousSource = setErrorSource(NULL);
+  armErrorTrap(&trap);
+  if (setjmp(trap.env) == 0) {
+    do {
+      readValidToken(scanner, &token);
+
+      // a token starting past the edit, where an old token started
+      // too, is followed by the same tokens as before
+      if (token.offset >= offset + inserted) {
+        target = token.offset - inserted + removed;
+        while ((old < stream->count) && (stream->offsets[old] < target))
+          old ++;
+        if ((old < stream->count) && (stream->offsets[old] == target)) {
+          synced = 1;
+          break;
+        }
+      }
+
+      appendToken(fresh, &token, currentOffset(scanner));
+    } while (token.tokenType != TK_EOF);
+  } else {
+    fresh->failed = 1;
+    fresh->diagnostic = trap.diagnostic;
+  }
+  disarmErrorTrap();
+  setErrorSource(previousSource);
+  closeInputStream(scanner);
+
+  // splice: the old tokens before first, the fresh ones, then the old
+  // ones from the sync point on, moved by the size of the edit
+  kept = synced ? stream->count - old : 0;
+  count = first + fresh->count + kept;
+  if (count > stream->capacity)
+    growTokenStream(stream, count + count / 2);
+  if ((kept > 0) && (first + fresh->count != old))
+    moveTokens(stream, first + fresh->count, old, kept);
+  memcpy(stream->types + first, fresh->types, fresh->count * sizeof(uint8_t));
+  memcpy(stream->offsets + first, fresh->offsets, fresh->count * sizeof(SourceOffset));
+  memcpy(stream->lengths + first, fresh->lengths, fresh->count * sizeof(uint16_t));
+  memcpy(stream->values + first, fresh->values, fresh->count * sizeof(uint32_t));
+  if (inserted != removed)
+    for (i = first + fresh->count; i < count; i++)
+      stream->offsets[i] += inserted - removed;
+
+  if (edit != NULL) {
+    edit->first = first;
+    edit->removed = stream->count - first - kept;
+    edit->inserted = fresh->count;
+  }
+
+  if (synced) {
+    if (stream->failed)
+      stream->diagnostic.offset += inserted - removed;
+  } else {
+    stream->failed = fresh->failed;
+    stream->diagnostic = fresh->diagnostic;
+  }
+  stream->diagnostic.lineNo = stream->diagnostic.colNo = 0;
+  stream->count = count;
+  stream->text = text;
+  stream->textLimit = text + size;
+
+  freeTokenStream(fresh);
+}
+
+Token* readStreamToken(TokenStream *stream, int index, Token *token) {
+  const char *text;
+  int length;
+
+  if (index >= stream->count) {
+    if (stream->failed)
+      reportDiagnostic(&stream->diagnostic);
+    index = stream->count - 1;
+  }
+
+  token->tokenType = (TokenType) stream->types[index];
+  token->offset = stream->offsets[index];
+  token->value = (int) stream->values[index];
+
+  text = stream->text + stream->offsets[index];
+  length = stream->lengths[index];
+
+  switch (token->tokenType) {
+  case TK_NUMBER:
+    if (length > MAX_IDENT_LEN) length = MAX_IDENT_LEN;
+    memcpy(token->string, text, length);
+    token->string[length] = '\0';
+    break;
+  case TK_CHAR:
+    token->string[0] = (char) token->value;
+    token->string[1] = '\0';
+    break;
+  case TK_IDENT:
+    token->atom = (Atom) token->value;
+    if (length > MAX_IDENT_LEN) length = MAX_IDENT_LEN;
+    copyUpper(token->string, text, length, stream->textLimit);
+    break;
+  default:
+    // keywords carry their upper case spelling like identifiers do
+    if ((token->tokenType >= KW_PROGRAM) && (token->tokenType < SB_SEMICOLON))
+      copyUpper(token->string, text, length, stream->textLimit);
+  }
+  return token;
+}
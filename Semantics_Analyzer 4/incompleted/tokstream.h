@@ -0,0 +1,84 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __TOKSTREAM_H__
+#define __TOKSTREAM_H__
+
+#include <stdint.h>
+#include "token.h"
+#include "error.h"
+
+/* The tokens of a whole input, lexed up front and kept as parallel
+ * arrays indexed by token number. Token i spans lengths[i] bytes of
+ * source starting at offsets[i]; its text is not copied, so the input
+ * buffer must stay open for as long as tokens are read back.
+ *
+ * values[i] is the value of a number, the code of a constant char and
+ * the atom of an identifier.
+ *
+ * Lexing stops at the first lexical error. The error is kept with the
+ * stream and raised by readStreamToken when the reader asks for the
+ * token at that point, just as the incremental scanner would. */
+typedef struct {
+  const char *text;         /* the input buffer the tokens were lexed from */
+  const char *textLimit;
+  uint8_t *types;           /* TokenType */
+  SourceOffset *offsets;
+  uint16_t *lengths;
+  uint32_t *values;
+  int count;                /* tokens lexed; the last is TK_EOF unless failed */
+  int capacity;
+  int failed;
+  Diagnostic diagnostic;    /* the lexical error that stopped lexing */
+  void *mapping;            /* the token cache file types, offsets and
+                               lengths point into, or NULL */
+  size_t mappingSize;
+} TokenStream;
+
+/* The tokens an edit replaced: tokens [first, first + removed) of the
+ * old stream became tokens [first, first + inserted) of the new one, and
+ * the tokens after them only moved */
+typedef struct {
+  int first;
+  int removed;
+  int inserted;
+} TokenEdit;
+
+/* Lexes the rest of the scanner's input, which must be a whole buffer
+ * rather than a stream */
+TokenStream *tokenizeInput(Scanner *scanner);
+
+/* Same as tokenizeInput, with the input cut into chunks of whole lines
+ * that are lexed on up to threads threads at once, or one per processor
+ * when threads is 0. A chunk is lexed as if no comment were open at its
+ * start; the tokens from the first one that starts where the previous
+ * chunk's tokens lead are kept, and those before it lexed again. Inputs
+ * too small to be worth it are lexed by tokenizeInput. Identifiers are
+ * interned in a different order, but the stream is otherwise the same. */
+TokenStream *tokenizeInputParallel(Scanner *scanner, int threads);
+void freeTokenStream(TokenStream *stream);
+
+/* Brings a stream up to date after an edit of its text. The removed
+ * bytes at offset of the old text were replaced with the inserted bytes
+ * at offset of text, the whole edited buffer of the given size, which
+ * the stream borrows from then on.
+ *
+ * Lexing restarts at the end of the last token before the edit and
+ * stops as soon as a token starts at the same place in the unchanged
+ * rest of the text as one of the old tokens, so its cost follows the
+ * size of the edit rather than of the text. Comments and char constants
+ * opened or closed by the edit are re-lexed until they line up again.
+ * The line and column of a diagnostic kept across an edit are worked
+ * out again when it is raised. edit may be NULL. */
+void relexTokenStream(TokenStream *stream, const char *text, size_t size,
+                      SourceOffset offset, SourceOffset removed, SourceOffset inserted,
+                      TokenEdit *edit);
+
+/* Unpacks token index into token, string included. Past the end this
+ * keeps returning the TK_EOF token, or raises the recorded error. */
+Token* readStreamToken(TokenStream *stream, int index, Token *token);
+
+#endif
@@ -0,0 +1,330 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+/* Scanner benchmark, built and run with "make bench".
+ *
+ * The token dump of every example in the test directory, printed by
+ * scan() and written by dumpFile(), is checked against its golden result
+ * first; if one differs nothing is measured. Then getToken() is run over
+ * each file of the corpus, and the best of BENCH_ROUNDS runs is reported
+ * as MB/s, tokens/s and heap allocations per token, followed by how fast
+ * each way of dumping the tokens writes them to /dev/null.
+ *
+ * usage: bench [-t dir] [-s MB] [-o file.csv] [file.kpl ...]
+ *   -t dir     where exampleN.kpl and resultN.txt are (default ../test)
+ *   -s MB      size of each generated file (default 16)
+ *   -o file    also append a CSV line per file, to track the numbers
+ *   file.kpl   the corpus; the examples and generated files if none */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "reader.h"
+#include "token.h"
+#include "scanner.h"
+#include "dump.h"
+
+#define BENCH_ROUNDS 5
+#define MAX_EXAMPLES 16
+#define MAX_CORPUS 64
+#define MAX_PATH_LEN 256
+#define MAX_LINE_LEN 256
+
+/* The link wraps malloc, so that the allocations the scanner makes are
+ * counted; the C library's own are not */
+void *__real_malloc(size_t size);
+
+long allocations = 0;
+
+void *__wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Scans fileName with stdout sent to a temporary file, and compares
+ * what scan(), or dumpFile() when fast, printed with the golden file
+ * line by line */
+int verifyGolden(char *fileName, char *goldenName, int fast) {
+    FILE *dump, *golden;
+    char line[MAX_LINE_LEN], expected[MAX_LINE_LEN];
+    int saved, lineNo = 0, result = 1;
+    char *got, *want;
+
+    golden = fopen(goldenName, "rt");
+    dump = tmpfile();
+    if (golden == NULL || dump == NULL) {
+        printf("  %s: can\'t read golden file\n", goldenName);
+        if (golden != NULL) fclose(golden);
+        if (dump != NULL) fclose(dump);
+        return 0;
+    }
+
+    fflush(stdout);
+    saved = dup(STDOUT_FILENO);
+    dup2(fileno(dump), STDOUT_FILENO);
+    if ((fast ? dumpFile(fileName, STDOUT_FILENO, DUMP_TEXT) : scan(fileName)) == IO_ERROR)
+        result = 0;
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    if (result == 0) {
+        printf("  %s: can\'t read input file\n", fileName);
+    } else {
+        rewind(dump);
+        do {
+            lineNo++;
+            got = fgets(line, MAX_LINE_LEN, dump);
+            want = fgets(expected, MAX_LINE_LEN, golden);
+            if (got == NULL && want == NULL)
+                break;
+            if (got == NULL || want == NULL || strcmp(line, expected) != 0) {
+                printf("  %s: line %d of the %s differs from %s\n", fileName, lineNo,
+                   fast ? "dump" : "printout", goldenName);
+                printf("    got      %s", got == NULL ? "end of dump\n" : line);
+                printf("    expected %s", want == NULL ? "end of file\n" : expected);
+                result = 0;
+            }
+        } while (result);
+    }
+
+    fclose(dump);
+    fclose(golden);
+    return result;
+}
+
+/* Scans fileName to the end once; returns the number of tokens */
+long runScanner(char *fileName) {
+    Token *token;
+    long count = 1;
+
+    if (openInputStream(fileName) == IO_ERROR)
+        return -1;
+    while ((token = getToken())->tokenType != TK_EOF) {
+        free(token);
+        count++;
+    }
+    free(token);
+    closeInputStream();
+    return count;
+}
+
+long fileSize(char *fileName) {
+    FILE *f = fopen(fileName, "rb");
+    long size;
+
+    if (f == NULL)
+        return -1;
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+int measure(char *name, char *fileName, FILE *csv) {
+    double best = 0, start, elapsed;
+    long size = fileSize(fileName), tokens = 0, allocated = 0;
+    int round;
+
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        allocations = 0;
+        start = now();
+        tokens = runScanner(fileName);
+        elapsed = now() - start;
+        allocated = allocations;
+        if (tokens < 0) {
+            printf("  %s: can\'t read input file\n", fileName);
+            return 0;
+        }
+        if (best == 0 || elapsed < best) best = elapsed;
+    }
+    if (best == 0) best = 1e-9;
+
+    printf("  %-24s %10ld bytes %8.1f MB/s %8.2f Mtokens/s %6.2f allocs/token\n",
+           name, size, size / best / 1e6, tokens / best / 1e6, (double) allocated / tokens);
+    if (csv != NULL)
+        fprintf(csv, "%ld,%s,%ld,%ld,%.6f,%.1f,%.3f,%.2f\n", (long) time(NULL), name,
+                size, tokens, best, size / best / 1e6, tokens / best / 1e6, (double) allocated / tokens);
+    return 1;
+}
+
+/* Dumps fileName to /dev/null once, with printToken() when format is
+ * -1; returns 0 if it could not be read */
+int runDump(char *fileName, int format) {
+    int saved, result, null = open("/dev/null", O_WRONLY);
+
+    if (null < 0)
+        return 0;
+    if (format >= 0) {
+        result = dumpFile(fileName, null, format);
+    } else {
+        fflush(stdout);
+        saved = dup(STDOUT_FILENO);
+        dup2(null, STDOUT_FILENO);
+        result = scan(fileName);
+        fflush(stdout);
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    }
+    close(null);
+    return result != IO_ERROR;
+}
+
+int measureDump(char *name, char *fileName, int format) {
+    double best = 0, start, elapsed;
+    long size = fileSize(fileName);
+    int round;
+
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        start = now();
+        if (!runDump(fileName, format)) {
+            printf("  %s: can\'t read input file\n", fileName);
+            return 0;
+        }
+        elapsed = now() - start;
+        if (best == 0 || elapsed < best) best = elapsed;
+    }
+    if (best == 0) best = 1e-9;
+
+    printf("  %-24s %10ld bytes %8.1f MB/s\n", name, size, size / best / 1e6);
+    return 1;
+}
+
+/* Writes size bytes of generated source to a temporary file. Dense
+ * files are statements, sparse ones mostly comments and blanks. */
+int makeCorpusFile(char *fileName, long size, int dense) {
+    static const char *statements[] = {
+        "  counter := counter + 1;\n",
+        "  IF n <= 0 THEN F := 1 ELSE F := N * F(N - 1);\n",
+        "  A(.i.) := A(.i - 1.) * 2147 / (j + 42);\n",
+        "  CALL WRITEC(' ');\n",
+        "  WHILE i >= 10 DO BEGIN i := i - 1; s := s + i END;\n",
+        "  FOR k := 1 TO 100 DO CALL WRITEI(k);\n"
+    };
+    static const char *sparse[] = {
+        "(* Generated procedure, do not edit. Stray ) and * characters\n"
+        "   keep the end of comment search honest: * ) ( **          *)\n",
+        "                                                            \n",
+        "  x := 1;\n"
+    };
+    const char **lines = dense ? statements : sparse;
+    int lineCount = dense ? sizeof(statements) / sizeof(statements[0])
+                          : sizeof(sparse) / sizeof(sparse[0]);
+    FILE *f;
+    long written = 0;
+    int fd, i = 0;
+
+    strcpy(fileName, "/tmp/kplbench-XXXXXX");
+    fd = mkstemp(fileName);
+    if (fd < 0 || (f = fdopen(fd, "wb")) == NULL)
+        return 0;
+
+    written += fprintf(f, "PROGRAM BENCH;\nBEGIN\n");
+    while (written < size - 8) {
+        const char *line = lines[i++ % lineCount];
+        if (written + (long) strlen(line) > size - 8) break;
+        written += fprintf(f, "%s", line);
+    }
+    fprintf(f, "END.\n");
+    fclose(f);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    char *testDir = "../test", *csvName = NULL;
+    char examples[MAX_EXAMPLES][MAX_PATH_LEN], golden[MAX_PATH_LEN];
+    char generated[2][MAX_PATH_LEN];
+    char *corpus[MAX_CORPUS], *dumped;
+    long generatedSize = 16;
+    int exampleCount = 0, corpusCount = 0, generatedCount = 0;
+    int failed = 0, i;
+    FILE *csv = NULL;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) testDir = argv[++i];
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) generatedSize = atol(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) csvName = argv[++i];
+        else if (argv[i][0] == '-') {
+            printf("usage: bench [-t dir] [-s MB] [-o file.csv] [file.kpl ...]\n");
+            return -1;
+        } else if (corpusCount < MAX_CORPUS) corpus[corpusCount++] = argv[i];
+    }
+
+    printf("golden token dumps, %s\n", testDir);
+    for (i = 1; i <= MAX_EXAMPLES; i++) {
+        snprintf(examples[exampleCount], MAX_PATH_LEN, "%s/example%d.kpl", testDir, i);
+        snprintf(golden, MAX_PATH_LEN, "%s/result%d.txt", testDir, i);
+        if (fileSize(examples[exampleCount]) < 0 || fileSize(golden) < 0)
+            break;
+        if (verifyGolden(examples[exampleCount], golden, 0) &&
+            verifyGolden(examples[exampleCount], golden, 1))
+            printf("  %-24s ok\n", examples[exampleCount]);
+        else failed = 1;
+        exampleCount++;
+    }
+    if (exampleCount == 0) {
+        printf("  no exampleN.kpl with a resultN.txt\n");
+        return -1;
+    }
+    if (failed) {
+        printf("token dumps differ, nothing measured\n");
+        return -1;
+    }
+
+    if (corpusCount == 0) {
+        for (i = 0; i < exampleCount; i++)
+            corpus[corpusCount++] = examples[i];
+        for (i = 0; i < 2; i++) {
+            if (!makeCorpusFile(generated[i], generatedSize << 20, i == 0)) {
+                printf("Can\'t write a generated file!\n");
+                break;
+            }
+            corpus[corpusCount++] = generated[i];
+            generatedCount++;
+        }
+    }
+
+    if (csvName != NULL) {
+        csv = fopen(csvName, "at");
+        if (csv == NULL)
+            printf("%s: can\'t append results\n", csvName);
+        else if (ftell(csv) == 0)
+            fprintf(csv, "time,file,bytes,tokens,seconds,MB/s,Mtokens/s,allocs/token\n");
+    }
+
+    printf("getToken(), best of %d runs\n", BENCH_ROUNDS);
+    for (i = 0; i < corpusCount; i++) {
+        char *name = corpus[i];
+        if (generatedCount > 0 && i >= corpusCount - generatedCount)
+            name = (i == corpusCount - generatedCount) ? "generated statements" : "generated comments";
+        if (!measure(name, corpus[i], csv))
+            failed = 1;
+    }
+
+    dumped = (generatedCount > 0) ? generated[0] : corpus[corpusCount - 1];
+    printf("token dumps of %s, best of %d runs\n",
+           (generatedCount > 0) ? "the generated statements" : dumped, BENCH_ROUNDS);
+    if (!measureDump("printToken()", dumped, -1) ||
+        !measureDump("text dump", dumped, DUMP_TEXT) ||
+        !measureDump("binary dump", dumped, DUMP_BINARY))
+        failed = 1;
+
+    for (i = 0; i < generatedCount; i++)
+        remove(generated[i]);
+    if (csv != NULL)
+        fclose(csv);
+    return failed ? -1 : 0;
+}
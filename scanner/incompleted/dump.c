@@ -0,0 +1,217 @@
+/* Token dump
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "reader.h"
+#include "scanner.h"
+#include "dump.h"
+
+#define DUMP_BUFFER_SIZE (1 << 16)
+/* longest text line: two numbers, the longest name and a string */
+#define MAX_DUMP_LINE 128
+
+/* What printToken prints for each token type, after the position */
+static const char *tokenNames[] = {
+    "TK_NONE", "TK_IDENT(", "TK_NUMBER(", "TK_CHAR(\'", "TK_EOF",
+
+    "KW_PROGRAM", "KW_CONST", "KW_TYPE", "KW_VAR",
+    "KW_INTEGER", "KW_CHAR", "KW_ARRAY", "KW_OF",
+    "KW_FUNCTION", "KW_PROCEDURE",
+    "KW_BEGIN", "KW_END", "KW_CALL",
+    "KW_IF", "KW_THEN", "KW_ELSE",
+    "KW_WHILE", "KW_DO", "KW_FOR", "KW_TO",
+
+    "SB_SEMICOLON", "SB_COLON", "SB_PERIOD", "SB_COMMA",
+    "SB_ASSIGN", "SB_EQ", "SB_NEQ", "SB_LT", "SB_LE", "SB_GT", "SB_GE",
+    "SB_PLUS", "SB_MINUS", "SB_TIMES", "SB_SLASH",
+    "SB_LPAR", "SB_RPAR", "SB_LSEL", "SB_RSEL"
+};
+
+static char buffer[DUMP_BUFFER_SIZE];
+static size_t used = 0;
+static int dumpFd = -1;
+static int dumpFormat = DUMP_TEXT;
+static int writeFailed = 0;
+
+static void flushBuffer(void) {
+    size_t done = 0;
+    ssize_t written;
+
+    while (done < used && !writeFailed) {
+        written = write(dumpFd, buffer + done, used - done);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            writeFailed = 1;
+        else done += written;
+    }
+    used = 0;
+}
+
+/* Makes room for size more bytes and returns where they go */
+static char *reserve(size_t size) {
+    if (used + size > DUMP_BUFFER_SIZE)
+        flushBuffer();
+    return buffer + used;
+}
+
+static char *putText(char *p, const char *text) {
+    while (*text != '\0')
+        *p++ = *text++;
+    return p;
+}
+
+static char *putNumber(char *p, int n) {
+    char digits[12];
+    int count = 0;
+    unsigned int u = (n < 0) ? 0u - (unsigned int) n : (unsigned int) n;
+
+    if (n < 0)
+        *p++ = '-';
+    do {
+        digits[count++] = '0' + u % 10;
+        u /= 10;
+    } while (u != 0);
+    while (count > 0)
+        *p++ = digits[--count];
+    return p;
+}
+
+static char *putPosition(char *p, int lineNo, int colNo) {
+    p = putNumber(p, lineNo);
+    *p++ = '-';
+    p = putNumber(p, colNo);
+    *p++ = ':';
+    return p;
+}
+
+static void putRecord(int type, int lineNo, int colNo, int value, char *string) {
+    unsigned char *p = (unsigned char*) reserve(sizeof(DumpRecord));
+    uint32_t fields[3];
+    size_t length = (string == NULL) ? 0 : strlen(string);
+    int i, k;
+
+    if (length > MAX_IDENT_LEN)
+        length = MAX_IDENT_LEN;
+    fields[0] = (uint32_t) lineNo;
+    fields[1] = (uint32_t) colNo;
+    fields[2] = (uint32_t) value;
+
+    // written byte by byte, so the record is little endian on any host
+    memset(p, 0, sizeof(DumpRecord));
+    p[0] = (unsigned char) type;
+    p[1] = (unsigned char) length;
+    for (i = 0; i < 3; i++)
+        for (k = 0; k < 4; k++)
+            p[4 + 4 * i + k] = (unsigned char) (fields[i] >> (8 * k));
+    if (length > 0)
+        memcpy(p + 16, string, length);
+    used += sizeof(DumpRecord);
+}
+
+void openTokenDump(int fd, int format) {
+    unsigned char *p;
+    int k;
+
+    dumpFd = fd;
+    dumpFormat = format;
+    used = 0;
+    writeFailed = 0;
+
+    if (format == DUMP_BINARY) {
+        p = (unsigned char*) buffer;
+        memcpy(p, DUMP_MAGIC, 8);
+        for (k = 0; k < 4; k++)
+            p[8 + k] = (unsigned char) (DUMP_VERSION >> (8 * k));
+        used = 12;
+    }
+}
+
+int tokenDumpOpen(void) {
+    return dumpFd >= 0;
+}
+
+void dumpToken(Token *token) {
+    char *p;
+
+    if (dumpFormat == DUMP_BINARY) {
+        switch (token->tokenType) {
+            case TK_IDENT:
+            case TK_CHAR:
+                putRecord(token->tokenType, token->lineNo, token->colNo, 0, token->string);
+                break;
+            case TK_NUMBER:
+                putRecord(token->tokenType, token->lineNo, token->colNo, token->value, token->string);
+                break;
+            default:
+                putRecord(token->tokenType, token->lineNo, token->colNo, 0, NULL);
+        }
+        return;
+    }
+
+    p = reserve(MAX_DUMP_LINE);
+    p = putPosition(p, token->lineNo, token->colNo);
+    p = putText(p, tokenNames[token->tokenType]);
+    switch (token->tokenType) {
+        case TK_IDENT:
+        case TK_NUMBER:
+            p = putText(p, token->string);
+            *p++ = ')';
+            break;
+        case TK_CHAR:
+            p = putText(p, token->string);
+            *p++ = '\'';
+            *p++ = ')';
+            break;
+        default:
+            break;
+    }
+    *p++ = '\n';
+    used = p - buffer;
+}
+
+void dumpError(int err, int lineNo, int colNo, char *message) {
+    char *p;
+
+    if (dumpFormat == DUMP_BINARY) {
+        putRecord(DUMP_ERROR, lineNo, colNo, err, NULL);
+        return;
+    }
+
+    p = reserve(MAX_DUMP_LINE);
+    p = putPosition(p, lineNo, colNo);
+    p = putText(p, message);
+    *p++ = '\n';
+    used = p - buffer;
+}
+
+int closeTokenDump(void) {
+    flushBuffer();
+    dumpFd = -1;
+    return !writeFailed;
+}
+
+int dumpFile(char *fileName, int fd, int format) {
+    Token *token;
+
+    if (openInputStream(fileName) == IO_ERROR)
+        return IO_ERROR;
+
+    openTokenDump(fd, format);
+    token = getToken();
+    while (token->tokenType != TK_EOF) {
+        dumpToken(token);
+        free(token);
+        token = getToken();
+    }
+
+    free(token);
+    closeInputStream();
+    return closeTokenDump() ? IO_SUCCESS : IO_ERROR;
+}
@@ -0,0 +1,51 @@
+/* Token dump
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __DUMP_H__
+#define __DUMP_H__
+
+#include <stdint.h>
+#include "token.h"
+
+#define DUMP_TEXT 0
+#define DUMP_BINARY 1
+
+#define DUMP_MAGIC "KPLDUMP"
+#define DUMP_VERSION 1
+#define DUMP_ERROR 0xFF
+
+/* A binary dump starts with the 8 bytes of DUMP_MAGIC, its terminating
+ * zero included, and the version as 4 bytes, followed by one record per
+ * token or lexical error, in the order the text dump prints them. All
+ * numbers are little endian.
+ *
+ * An error record has type DUMP_ERROR and its ErrorCode as value. Only
+ * identifiers, numbers and char constants have a string, and only
+ * numbers a value; the rest are zero. */
+typedef struct {
+    uint8_t type;                   /* TokenType, or DUMP_ERROR */
+    uint8_t length;                 /* of string */
+    uint16_t reserved;
+    int32_t lineNo, colNo;
+    int32_t value;
+    char string[MAX_IDENT_LEN + 1];
+} DumpRecord;
+
+/* Sends the dump to the file descriptor fd, in the given format. The
+ * output is gathered in a buffer and written out when it fills up, so
+ * nothing else may write to fd until the dump is closed. */
+void openTokenDump(int fd, int format);
+int tokenDumpOpen(void);
+void dumpToken(Token *token);
+void dumpError(int err, int lineNo, int colNo, char *message);
+/* Writes out what is left in the buffer; returns 0 if a write failed */
+int closeTokenDump(void);
+
+/* Dumps every token of fileName but the last, TK_EOF, as scan() prints
+ * them, to fd */
+int dumpFile(char *fileName, int fd, int format);
+
+#endif
@@ -7,22 +7,33 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "error.h"
+#include "dump.h"
 
 void error(ErrorCode err, int lineNo, int colNo) {
+  char *message = "";
+
   switch (err) {
   case ERR_ENDOFCOMMENT:
-    printf("%d-%d:%s\n", lineNo, colNo, ERM_ENDOFCOMMENT);
+    message = ERM_ENDOFCOMMENT;
     break;
   case ERR_IDENTTOOLONG:
-    printf("%d-%d:%s\n", lineNo, colNo, ERM_IDENTTOOLONG);
+    message = ERM_IDENTTOOLONG;
     break;
   case ERR_INVALIDCHARCONSTANT:
-    printf("%d-%d:%s\n", lineNo, colNo, ERM_INVALIDCHARCONSTANT);
+    message = ERM_INVALIDCHARCONSTANT;
+    break;
+  case ERR_INVALIDSYMBOL:
+    message = ERM_INVALIDSYMBOL;
     break;
   case ERR_NUMBER_TO0LONG:
-    printf("%d-%d:%s\n", lineNo, colNo, ERM_NUMBER_TO0LONG);
+    message = ERM_NUMBER_TO0LONG;
     break;
   }
+
+  // an open dump gets the error between its tokens, in order
+  if (tokenDumpOpen())
+    dumpError(err, lineNo, colNo, message);
+  else printf("%d-%d:%s\n", lineNo, colNo, message);
 //  exit(-1);
 }
 
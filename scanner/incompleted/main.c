@@ -0,0 +1,33 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "reader.h"
+#include "scanner.h"
+#include "dump.h"
+
+/******************************************************************/
+
+/* usage: scanner [-b] [file.kpl]
+ *   -b         dump the tokens in binary, see dump.h
+ *   file.kpl   the input (default example3.kpl) */
+int main(int argc, char *argv[]) {
+    char *fileName = "example3.kpl";
+    int format = DUMP_TEXT, i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-b") == 0) format = DUMP_BINARY;
+        else fileName = argv[i];
+    }
+
+    if (dumpFile(fileName, STDOUT_FILENO, format) == IO_ERROR) {
+        printf("Can\'t read input file!\n");
+        return -1;
+    }
+    return 0;
+}
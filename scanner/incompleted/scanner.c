@@ -12,6 +12,7 @@
 #include "charcode.h"
 #include "token.h"
 #include "error.h"
+#include "scanner.h"
 
 extern int lineNo;
 extern int colNo;
@@ -91,12 +92,14 @@ Token *readNumber(void) {
     string[index] = '\0';
     char strNumber[MAX_NUMBER_LEN + 1];
     sprintf(strNumber, "%d", INT_MAX);
-    if (strcmp(string, strNumber) > 0){
+    // only a number as long as INT_MAX can compare greater as a string
+    if (index == (int) strlen(strNumber) && strcmp(string, strNumber) > 0){
         error(ERR_NUMBER_TO0LONG, lineNo, colNo);
         return token;
     }
     token->tokenType = TK_NUMBER;
     strcpy(token->string,string);
+    token->value = atoi(string);
     return token;
 }//OKE
 
@@ -106,11 +109,11 @@ Token *readConstChar(void) {
     int cl = colNo;
     int ll = lineNo;
     readChar();
-    if (currentChar != EOF && charCodes[currentChar] == CHAR_LETTER) {
+    if (currentChar != EOF && currentChar != '\n') {
         cr = currentChar;
         readChar();
         if (currentChar != EOF && charCodes[currentChar] == CHAR_SINGLEQUOTE) {
-            token = makeToken(TK_CHAR, lineNo, colNo);
+            token = makeToken(TK_CHAR, ll, cl);
             token->string[0] = cr;
             token->string[1] = '\0';
             readChar();
@@ -139,14 +142,19 @@ Token *getToken(void) {
             readChar();
             return token;
         case CHAR_LPAR :
+            ln = lineNo;
+            cn = colNo;
             readChar();
-            if (charCodes[currentChar] == CHAR_TIMES)
+            if (currentChar != EOF && charCodes[currentChar] == CHAR_TIMES) {
+                readChar();
                 skipComment();
-            else if(charCodes[currentChar] == CHAR_PERIOD)
-                return makeToken(SB_LSEL, lineNo, colNo);
-            else
-                return makeToken(SB_LPAR, lineNo, colNo);
-            return getToken();
+                return getToken();
+            }
+            if (currentChar != EOF && charCodes[currentChar] == CHAR_PERIOD) {
+                readChar();
+                return makeToken(SB_LSEL, ln, cn);
+            }
+            return makeToken(SB_LPAR, ln, cn);
         case CHAR_MINUS:
             token = makeToken(SB_MINUS, lineNo, colNo);
             readChar();
@@ -172,41 +180,50 @@ Token *getToken(void) {
             readChar();
             return token;
         case CHAR_PERIOD:
+            token = makeToken(SB_PERIOD, lineNo, colNo);
             readChar();
-            if (charCodes[currentChar] == CHAR_RPAR)
-                token = makeToken(SB_RSEL, lineNo, colNo);
-            else token = makeToken(SB_PERIOD, lineNo, colNo - 1);
+            if (currentChar != EOF && charCodes[currentChar] == CHAR_RPAR) {
+                token->tokenType = SB_RSEL;
+                readChar();
+            }
             return token;
         case CHAR_COLON:
+            token = makeToken(SB_COLON, lineNo, colNo);
             readChar();
-            if (charCodes[currentChar] == CHAR_EQ)
-                token = makeToken(SB_ASSIGN, lineNo, colNo);
-            else token = makeToken(SB_COLON, lineNo, colNo);
-            readChar();
+            if (currentChar != EOF && charCodes[currentChar] == CHAR_EQ) {
+                token->tokenType = SB_ASSIGN;
+                readChar();
+            }
             return token;
         case CHAR_LT:
+            token = makeToken(SB_LT, lineNo, colNo);
             readChar();
-            if (charCodes[currentChar] == CHAR_EQ)
-                token = makeToken(SB_LE, lineNo, colNo);
-            else token = makeToken(SB_LT, lineNo, colNo);
+            if (currentChar != EOF && charCodes[currentChar] == CHAR_EQ) {
+                token->tokenType = SB_LE;
+                readChar();
+            }
             return token;
         case CHAR_SINGLEQUOTE:
             return readConstChar();
         case CHAR_EXCLAIMATION:
+            token = makeToken(TK_NONE, lineNo, colNo);
             readChar();
-            if (charCodes[currentChar] == CHAR_EQ)
-                token = makeToken(SB_NEQ, lineNo, colNo);
-            else token = makeToken(TK_NONE, lineNo, colNo);
-            readChar();
+            if (currentChar != EOF && charCodes[currentChar] == CHAR_EQ) {
+                token->tokenType = SB_NEQ;
+                readChar();
+            } else error(ERR_INVALIDSYMBOL, token->lineNo, token->colNo);
             return token;
         case CHAR_RPAR:
+            token = makeToken(SB_RPAR, lineNo, colNo);
             readChar();
-            return makeToken(SB_RPAR, lineNo, colNo);
+            return token;
         case CHAR_GT:
+            token = makeToken(SB_GT, lineNo, colNo);
             readChar();
-            if(charCodes[currentChar] == CHAR_EQ)
-                return makeToken(SB_GE, lineNo, colNo);
-            else token = makeToken(SB_GT, lineNo, colNo);
+            if (currentChar != EOF && charCodes[currentChar] == CHAR_EQ) {
+                token->tokenType = SB_GE;
+                readChar();
+            }
             return token;
         default:
             token = makeToken(TK_NONE, lineNo, colNo);
@@ -376,26 +393,3 @@ int scan(char *fileName) {
     closeInputStream();
     return IO_SUCCESS;
 }
-
-/******************************************************************/
-
-//int main(int argc, char *argv[]) {
-//    if (argc <= 1) {
-//        printf("scanner: no input file.\n");
-//        return -1;
-//    }
-//
-//    if (scan(argv[1]) == IO_ERROR) {
-//        printf("Can\'t read input file!\n");
-//        return -1;
-//    }
-//}
-int main(int argc, char *argv[]) {
-    if (scan("example3.kpl") == IO_ERROR) {
-        printf("Can\'t read input file!\n");
-        return -1;
-    }
-}
-
-
-
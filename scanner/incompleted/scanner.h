@@ -0,0 +1,18 @@
+/* Scanner
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __SCANNER_H__
+#define __SCANNER_H__
+
+#include "token.h"
+
+Token* getToken(void);
+void printToken(Token *token);
+
+/* Prints every token of fileName but the last, TK_EOF */
+int scan(char *fileName);
+
+#endif